@@ -1,11 +1,17 @@
 //
 // Created by manuel on 28/12/2021.
 //
+#include "SDL.h"
 #include "src/Chip8.h"
+#include "src/Debugger.h"
+#include "src/RomStore.h"
 
 
 bool readInput(Chip8*, SDL_Event*);
 bool initGraphics(SDL_Texture** tex, SDL_Window** win, SDL_Renderer** ren);
+bool parseDebugArgs(int argc, char** argv, Debugger* dbg);
+Profile parseProfile(int argc, char** argv);
+void printStop(const Chip8& emu, const Debugger& dbg);
 
 int main(int argc, char** argv){
     if (argc < 2){
@@ -13,6 +19,18 @@ int main(int argc, char** argv){
         return 1;
     }
 
+    // Optional debugger arguments after the ROM: -b addr, -w begin:end, -t
+    Debugger dbg;
+    bool debugging = parseDebugArgs(argc, argv, &dbg);
+
+    // Before any window opens, so a bad ROM only costs the message
+    Chip8 emu;
+    if (!emu.loadRom(argv[1], parseProfile(argc, argv))){
+        std::cout << RomStore::process().error() << std::endl;
+        return 1;
+    }
+    if (debugging) emu.debugger = &dbg;
+
     SDL_Event e;
     SDL_Window* window{};
     SDL_Renderer* renderer{};
@@ -20,9 +38,9 @@ int main(int argc, char** argv){
     SDL_Init(SDL_INIT_VIDEO);
     if (!initGraphics(&texture, &window, &renderer)) return -1;
 
-    Chip8 emu;
-    emu.loadRom(argv[1]);
     bool quit;
+    bool reported = false;
+    uint32_t pixels[VIDEO_WIDTH * VIDEO_HEIGHT]{};
 
     auto old_time = std::chrono::system_clock::now();
     auto c_time = std::chrono::system_clock::now();
@@ -34,12 +52,21 @@ int main(int argc, char** argv){
         if (diff.count() < 5e-3)
             continue;
         else old_time = c_time;
-        emu.run();
+
+        if (debugging) {
+            emu.run<true>();
+            if (dbg.stopped() && !reported) printStop(emu, dbg);
+            reported = dbg.stopped();
+        }
+        else emu.run();
 
 //        if (emu.drawFlag) {
 //        }
 //        emu.drawFlag = false;
-        SDL_UpdateTexture(texture, nullptr, emu.video, VIDEO_WIDTH*4);
+        for (int y=0; y<VIDEO_HEIGHT; ++y)
+            for (int x=0; x<VIDEO_WIDTH; ++x)
+                pixels[y * VIDEO_WIDTH + x] = emu.pixel(x, y) ? 0xFFFFFFFF : 0;
+        SDL_UpdateTexture(texture, nullptr, pixels, VIDEO_WIDTH*4);
         SDL_RenderClear(renderer);
         SDL_RenderCopy(renderer, texture, nullptr, nullptr);
         SDL_RenderPresent(renderer);
@@ -52,7 +79,7 @@ int main(int argc, char** argv){
 }
 
 bool initGraphics(SDL_Texture** tex, SDL_Window** win, SDL_Renderer** ren){
-    *win = SDL_CreateWindow("Chip-8",0, 0, VIDEO_WIDTH*10, VIDEO_HEIGHT*10, SDL_WINDOW_SHOWN);
+    *win = SDL_CreateWindow("Chip-8",0, 0, VIDEO_WIDTH*5, VIDEO_HEIGHT*5, SDL_WINDOW_SHOWN);
     if (*win == nullptr){
         std::cout << SDL_GetError() << std::endl;
         return false;
@@ -73,6 +100,46 @@ bool initGraphics(SDL_Texture** tex, SDL_Window** win, SDL_Renderer** ren){
     return true;
 }
 
+bool parseDebugArgs(int argc, char** argv, Debugger* dbg){
+    bool debugging = false;
+    for (int i=2; i<argc; ++i){
+        if (!std::strcmp(argv[i], "-b") && i + 1 < argc){
+            dbg->addBreakpoint(std::strtoul(argv[++i], nullptr, 16));
+            debugging = true;
+        }
+        else if (!std::strcmp(argv[i], "-w") && i + 1 < argc){
+            char* end{};
+            unsigned long begin = std::strtoul(argv[++i], &end, 16);
+            unsigned long last = *end == ':' ? std::strtoul(end + 1, nullptr, 16) : begin + 1;
+            dbg->addWatchpoint(begin, last, WATCH_READ_WRITE);
+            debugging = true;
+        }
+        else if (!std::strcmp(argv[i], "-t")){
+            dbg->trace = true;
+            debugging = true;
+        }
+    }
+    return debugging;
+}
+
+// -q vip|chip48|schip selects the quirk profile the ROM was written for
+Profile parseProfile(int argc, char** argv){
+    for (int i=2; i+1<argc; ++i){
+        if (!std::strcmp(argv[i], "-q")) return profileFromName(argv[i+1]);
+    }
+    return Profile::Modern;
+}
+
+void printStop(const Chip8& emu, const Debugger& dbg){
+    if (dbg.reason == StopReason::Watchpoint)
+        printf("Watchpoint at pc = 0x%03X, mem[0x%03X]\n", dbg.stopPc, dbg.stopAddr);
+    else
+        printf("Breakpoint at pc = 0x%03X\n", dbg.stopPc);
+
+    for (unsigned int i=0; i<16; ++i) printf("V%X=%02X ", i, emu.registers[i]);
+    printf("\nI=%03X sp=%X DT=%02X ST=%02X  (F5 to resume)\n", emu.index, emu.sp, emu.delayTimer, emu.soundTimer);
+}
+
 bool readInput(Chip8* chip8, SDL_Event* e){
     while(SDL_PollEvent(e) != 0){
         //User presses a key
@@ -87,68 +154,72 @@ bool readInput(Chip8* chip8, SDL_Event* e){
                     case SDLK_ESCAPE:
                         return -1;
 
+                    case SDLK_F5:
+                        if (chip8->debugger) chip8->debugger->resume();
+                        break;
+
                     case SDLK_1:
-                        chip8->keypad[0] = 1;
+                        chip8->setKey(0, true);
                         break;
 
                     case SDLK_2:
-                        chip8->keypad[1] = 1;
+                        chip8->setKey(1, true);
                         break;
 
                     case SDLK_3:
-                        chip8->keypad[2] = 1;
+                        chip8->setKey(2, true);
                         break;
 
                     case SDLK_4:
-                        chip8->keypad[3] = 1;
+                        chip8->setKey(3, true);
                         break;
 
                     case SDLK_q:
-                        chip8->keypad[4] = 1;
+                        chip8->setKey(4, true);
                         break;
 
                     case SDLK_w:
-                        chip8->keypad[5] = 1;
+                        chip8->setKey(5, true);
                         break;
 
                     case SDLK_e:
-                        chip8->keypad[6] = 1;
+                        chip8->setKey(6, true);
                         break;
 
                     case SDLK_r:
-                        chip8->keypad[7] = 1;
+                        chip8->setKey(7, true);
                         break;
 
                     case SDLK_a:
-                        chip8->keypad[8] = 1;
+                        chip8->setKey(8, true);
                         break;
 
                     case SDLK_s:
-                        chip8->keypad[9] = 1;
+                        chip8->setKey(9, true);
                         break;
 
                     case SDLK_d:
-                        chip8->keypad[10] = 1;
+                        chip8->setKey(10, true);
                         break;
 
                     case SDLK_f:
-                        chip8->keypad[11] = 1;
+                        chip8->setKey(11, true);
                         break;
 
                     case SDLK_z:
-                        chip8->keypad[12] = 1;
+                        chip8->setKey(12, true);
                         break;
 
                     case SDLK_x:
-                        chip8->keypad[13] = 1;
+                        chip8->setKey(13, true);
                         break;
 
                     case SDLK_c:
-                        chip8->keypad[14] = 1;
+                        chip8->setKey(14, true);
                         break;
 
                     case SDLK_v:
-                        chip8->keypad[15] = 1;
+                        chip8->setKey(15, true);
                         break;
                 }
                 break;
@@ -157,67 +228,67 @@ bool readInput(Chip8* chip8, SDL_Event* e){
                 switch( e->key.keysym.sym )
                 {
                     case SDLK_1:
-                        chip8->keypad[0] = 0;
+                        chip8->setKey(0, false);
                         break;
 
                     case SDLK_2:
-                        chip8->keypad[1] = 0;
+                        chip8->setKey(1, false);
                         break;
 
                     case SDLK_3:
-                        chip8->keypad[2] = 0;
+                        chip8->setKey(2, false);
                         break;
 
                     case SDLK_4:
-                        chip8->keypad[3] = 0;
+                        chip8->setKey(3, false);
                         break;
 
                     case SDLK_q:
-                        chip8->keypad[4] = 0;
+                        chip8->setKey(4, false);
                         break;
 
                     case SDLK_w:
-                        chip8->keypad[5] = 0;
+                        chip8->setKey(5, false);
                         break;
 
                     case SDLK_e:
-                        chip8->keypad[6] = 0;
+                        chip8->setKey(6, false);
                         break;
 
                     case SDLK_r:
-                        chip8->keypad[7] = 0;
+                        chip8->setKey(7, false);
                         break;
 
                     case SDLK_a:
-                        chip8->keypad[8] = 0;
+                        chip8->setKey(8, false);
                         break;
 
                     case SDLK_s:
-                        chip8->keypad[9] = 0;
+                        chip8->setKey(9, false);
                         break;
 
                     case SDLK_d:
-                        chip8->keypad[10] = 0;
+                        chip8->setKey(10, false);
                         break;
 
                     case SDLK_f:
-                        chip8->keypad[11] = 0;
+                        chip8->setKey(11, false);
                         break;
 
                     case SDLK_z:
-                        chip8->keypad[12] = 0;
+                        chip8->setKey(12, false);
                         break;
 
                     case SDLK_x:
-                        chip8->keypad[13] = 0;
+                        chip8->setKey(13, false);
                         break;
 
                     case SDLK_c:
-                        chip8->keypad[14] = 0;
+                        chip8->setKey(14, false);
                         break;
 
                     case SDLK_v:
-                        chip8->keypad[15] = 0;
+                        chip8->setKey(15, false);
                         break;
                 }
                 break;
@@ -0,0 +1,18 @@
+#include "Backends.h"
+
+
+const std::vector<BackendInfo> BACKENDS = {
+        {"switch", [](Chip8& emu, unsigned int cycles) { emu.run(cycles); },
+                   [](Chip8& emu, unsigned int cycles) { emu.runUntimed(cycles); }},
+        {"table",  [](Chip8& emu, unsigned int cycles) { emu.runTable(cycles); },
+                   [](Chip8& emu, unsigned int cycles) { emu.runTableUntimed(cycles); }},
+        {"debug",  [](Chip8& emu, unsigned int cycles) { emu.run<true>(cycles); },
+                   [](Chip8& emu, unsigned int cycles) { emu.runUntimed<true>(cycles); }},
+};
+
+const BackendInfo* findBackend(const std::string& name) {
+    for (const BackendInfo& backend : BACKENDS) {
+        if (name == backend.name) return &backend;
+    }
+    return nullptr;
+}
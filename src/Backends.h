@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Chip8.h"
+
+// Registry of the execution paths the core offers, for tools that compare
+// or measure them
+
+// Advance emu by `cycles` instructions
+using Backend = void (*)(Chip8& emu, unsigned int cycles);
+
+struct BackendInfo {
+    const char* name;
+    Backend run;      // Timers tick after every instruction
+    Backend untimed;  // Timers left alone: a frame is these plus Chip8::tickTimers()
+};
+
+// The first entry is the reference implementation
+extern const std::vector<BackendInfo> BACKENDS;
+const BackendInfo* findBackend(const std::string& name);
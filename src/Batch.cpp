@@ -0,0 +1,128 @@
+#include "Batch.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+// One output byte (0 or 1) per bit of `bits`, MSB first
+static void expandBits(uint64_t bits, unsigned int count, uint8_t* out) {
+#ifdef __SSE2__
+    const __m128i select = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, char(128),
+                                        1, 2, 4, 8, 16, 32, 64, char(128));
+    const __m128i one = _mm_set1_epi8(1);
+    for (unsigned int i=0; i<count; i+=16) {
+        uint64_t b0 = (bits >> (56 - i)) & 0xFFu;
+        uint64_t b1 = (bits >> (48 - i)) & 0xFFu;
+        // Broadcast each source byte over 8 lanes, keep one bit per lane
+        __m128i v = _mm_set_epi64x(b1 * 0x0101010101010101ull, b0 * 0x0101010101010101ull);
+        v = _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_and_si128(v, one));
+    }
+#else
+    for (unsigned int i=0; i<count; ++i) out[i] = (bits >> (63 - i)) & 1u;
+#endif
+}
+
+// Keep the odd bits of x (63, 61, ..., 1) and compact them into the low 32
+static uint64_t compactPairs(uint64_t x) {
+    x = (x >> 1) & 0x5555555555555555ull;
+    x = (x | x >> 1) & 0x3333333333333333ull;
+    x = (x | x >> 2) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x >> 4) & 0x00FF00FF00FF00FFull;
+    x = (x | x >> 8) & 0x0000FFFF0000FFFFull;
+    x = (x | x >> 16) & 0x00000000FFFFFFFFull;
+    return x;
+}
+
+// Each of the low 32 bits of x twice, MSB first
+static uint64_t doubleBits(uint64_t x) {
+    x &= 0x00000000FFFFFFFFull;
+    x = (x | x << 16) & 0x0000FFFF0000FFFFull;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFull;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x << 2) & 0x3333333333333333ull;
+    x = (x | x << 1) & 0x5555555555555555ull;
+    return x | x << 1;
+}
+
+// Row y of the VIDEO_WIDTH x VIDEO_HEIGHT frame, low-res pixels doubled
+static void frameRow(const Chip8& emu, int y, uint64_t* out) {
+    if (emu.hires) {
+        out[0] = emu.video[y][0];
+        out[1] = emu.video[y][1];
+    }
+    else {
+        uint64_t row = emu.video[y / 2][0];
+        out[0] = doubleBits(row >> 32);
+        out[1] = doubleBits(row);
+    }
+}
+
+size_t observationSize(ObsFormat format) {
+    switch (format) {
+        case ObsFormat::Packed1:
+            return VIDEO_WIDTH * VIDEO_HEIGHT / 8;
+        case ObsFormat::U8:
+            return VIDEO_WIDTH * VIDEO_HEIGHT;
+        case ObsFormat::Down2x:
+            return VIDEO_WIDTH * VIDEO_HEIGHT / 4;
+    }
+    return 0;
+}
+
+void exportObservation(const Chip8& emu, ObsFormat format, uint8_t* out) {
+    uint64_t row[2];
+
+    switch (format) {
+        case ObsFormat::Packed1:
+            for (int y=0; y<VIDEO_HEIGHT; ++y) {
+                frameRow(emu, y, row);
+                uint64_t bigEndian[2] = {__builtin_bswap64(row[0]), __builtin_bswap64(row[1])};
+                std::memcpy(out + y * VIDEO_WIDTH / 8, bigEndian, sizeof(bigEndian));
+            }
+            break;
+
+        case ObsFormat::U8:
+            for (int y=0; y<VIDEO_HEIGHT; ++y) {
+                frameRow(emu, y, row);
+                expandBits(row[0], 64, out + y * VIDEO_WIDTH);
+                expandBits(row[1], 64, out + y * VIDEO_WIDTH + 64);
+            }
+            break;
+
+        case ObsFormat::Down2x:
+            // A 2x2 block of the frame is exactly one low-res pixel
+            if (!emu.hires) {
+                for (int y=0; y<LORES_HEIGHT; ++y) expandBits(emu.video[y][0], LORES_WIDTH, out + y * LORES_WIDTH);
+                break;
+            }
+            for (int y=0; y<VIDEO_HEIGHT; y+=2) {
+                uint64_t left = emu.video[y][0] | emu.video[y + 1][0];
+                uint64_t right = emu.video[y][1] | emu.video[y + 1][1];
+                uint64_t pairs = compactPairs(left | left << 1) << 32 | compactPairs(right | right << 1);
+                expandBits(pairs, VIDEO_WIDTH / 2, out + (y / 2) * (VIDEO_WIDTH / 2));
+            }
+            break;
+    }
+}
+
+void exportState(const Chip8& emu, BatchState* out) {
+    std::memcpy(out->registers, emu.registers, sizeof(out->registers));
+    out->pc = emu.pc;
+    out->index = emu.index;
+    out->sp = emu.sp;
+    out->delayTimer = emu.delayTimer;
+    out->soundTimer = emu.soundTimer;
+    out->drawFlag = emu.drawFlag;
+}
+
+void stepBatch(Chip8* const* emus, size_t count, unsigned int frames, ObsFormat format,
+               uint8_t* observations, BatchState* states) {
+    const size_t stride = observationSize(format);
+    for (size_t i=0; i<count; ++i) {
+        Chip8& emu = *emus[i];
+        for (unsigned int frame=0; frame<frames; ++frame) emu.runFrame();
+        exportObservation(emu, format, observations + i * stride);
+        if (states) exportState(emu, &states[i]);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Chip8.h"
+
+// Dense observation export for stepping many Chip8 instances at once.
+// Displays are written back to back into one caller-owned buffer, always as
+// the VIDEO_WIDTH x VIDEO_HEIGHT frame: low-res pixels come out as 2x2 blocks.
+
+enum class ObsFormat : uint8_t {
+    Packed1,  // 1 bit per pixel, MSB leftmost, VIDEO_HEIGHT rows of VIDEO_WIDTH/8 bytes
+    U8,       // 1 byte per pixel, 0 or 1
+    Down2x    // 1 byte per 2x2 block, 1 if any pixel in it is lit. Low-res displays exactly.
+};
+
+// Machine state written next to each observation
+struct BatchState {
+    uint8_t registers[16];
+    uint16_t pc;
+    uint16_t index;
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t drawFlag;
+};
+
+// Bytes one display occupies in the given format
+size_t observationSize(ObsFormat format);
+
+// Write the display of emu to out, observationSize(format) bytes
+void exportObservation(const Chip8& emu, ObsFormat format, uint8_t* out);
+void exportState(const Chip8& emu, BatchState* out);
+
+// Run every instance for `frames` frames, then write instance i's display to
+// observations + i * observationSize(format) and its state to states[i].
+// states may be null.
+void stepBatch(Chip8* const* emus, size_t count, unsigned int frames, ObsFormat format,
+               uint8_t* observations, BatchState* states);
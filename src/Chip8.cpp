@@ -1,35 +1,106 @@
 #include "Chip8.h"
+#include "Debugger.h"
+#include "RomStore.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
+#include <cstddef>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+static_assert(offsetof(Chip8, mem) - offsetof(Chip8, registers) == 64, "hot state must fill exactly one cache line");
+static_assert(offsetof(Chip8, video) - offsetof(Chip8, registers) == 64 + MEMORY_SIZE, "state must stay contiguous");
+static_assert(offsetof(Chip8, flags) - offsetof(Chip8, video) == sizeof(Chip8::video), "state must stay contiguous");
+static_assert(sizeof(Chip8) <= 6 * 1024, "keep instances small enough to batch in L2");
+
+
+// One sequence for the whole process: a copy of an instance shares its epoch
+// only until either of them writes mem
+uint64_t Chip8::nextMemEpoch() {
+    static std::atomic<uint64_t> epochs{0};
+    return epochs.fetch_add(1, std::memory_order_relaxed) + 1;
+}
 
 Chip8::Chip8() : randGen(std::chrono::system_clock::now().time_since_epoch().count())
 {
+    memEpoch = nextMemEpoch();
+
+    setProfile(Profile::Modern);
+    randByte = std::uniform_int_distribution<uint8_t>(0, 255U);
+    reset();
+}
+
+void Chip8::seed(uint32_t value) {
+    randGen.seed(value);
+    randByte.reset();
+}
+
+// Back to power-on state. Profile, debugger and random engine are kept, the
+// ROM has to be loaded again.
+void Chip8::reset() {
+    std::memset(registers, 0, sizeof(registers));
+    std::memset(mem, 0, sizeof(mem));
+    std::memset(stack, 0, sizeof(stack));
+    keypad = 0;
+    std::memset(video, 0, sizeof(video));
+    index = 0;
+    sp = 0;
+    delayTimer = 0;
+    soundTimer = 0;
+    opcode = 0;
+
     pc = START_ADDRESS;
     for (unsigned int i=0; i<FONTSET_SIZE; ++i){
         mem[i + FONT_ADDRESS] = fontset[i];
     }
-
-    randByte = std::uniform_int_distribution<uint8_t>(0, 255U);
+    std::memcpy(mem + BIG_FONT_ADDRESS, bigFontset, BIG_FONTSET_SIZE);
     drawFlag = false;
+    hires = false;
+    touchMem();
 }
 
 
-void Chip8::loadRom(char const *filename){
-    std::ifstream romFile(filename, std::ios::binary | std::ios::ate); // Set initial position to end of the file
+// Select the specialised run loops for a quirk profile
+void Chip8::setProfile(Profile newProfile) {
+    profile = newProfile;
+    switch (profile) {
+        case Profile::CosmacVip: selectLoops<quirks::CosmacVip>(); break;
+        case Profile::Chip48: selectLoops<quirks::Chip48>(); break;
+        case Profile::SuperChip: selectLoops<quirks::SuperChip>(); break;
+        default: selectLoops<quirks::Modern>(); break;
+    }
+}
 
-    if (romFile.is_open()){
-        int length = romFile.tellg();
-        char romBuffer[length];
+template<class Quirks>
+void Chip8::selectLoops() {
+    step = &Chip8::execute<Quirks, false>;
+    debugStep = &Chip8::execute<Quirks, true>;
+    tableStep = &Chip8::executeTable<Quirks>;
+    untimedStep = &Chip8::execute<Quirks, false, false>;
+    untimedDebugStep = &Chip8::execute<Quirks, true, false>;
+    untimedTableStep = &Chip8::executeTable<Quirks, false>;
+}
 
-        romFile.seekg(0, std::ios::beg);
+// Through the process-wide RomStore, so instances share one image
+bool Chip8::loadRom(char const *filename, Profile romProfile){
+    std::shared_ptr<const RomImage> rom = RomStore::process().open(filename);
+    return rom && loadRom(rom->data, rom->size, romProfile);
+}
 
-        romFile.read(romBuffer, length);
-        romFile.close();
+bool Chip8::loadRom(const uint8_t* data, size_t size, Profile romProfile){
+    if (size > MEMORY_SIZE - START_ADDRESS) return false;
 
-        for (int i=0; i<length; ++i){
-            mem[START_ADDRESS+i] = (unsigned int)romBuffer[i];
-        }
-    }
+    setProfile(romProfile);
+    std::memcpy(mem + START_ADDRESS, data, size);
+    touchMem();
+    return true;
+}
+
+// Unassigned opcode, skip it
+void Chip8::OP_NULL() {
+    pc += 2;
 }
 
 // Clean display. Set all pixels to 0
@@ -38,9 +109,9 @@ void Chip8::OP_00E0() {
     pc += 2;
 }
 
-// RET. Set pc to top of the stack and decrement sp
+// RET. Set pc to top of the stack and decrement sp. sp wraps within the stack.
 void Chip8::OP_00EE() {
-    --sp;
+    sp = (sp - 1) & 0xFu;
     pc = stack[sp];
 }
 
@@ -52,8 +123,8 @@ void Chip8::OP_1nnn() {
 // CALL. Set top of the stack to pc, increment sp and set pc to nnn
 void Chip8::OP_2nnn() {
     pc += 2;
-    stack[sp] = pc;
-    ++sp;
+    stack[sp & 0xFu] = pc;
+    sp = (sp + 1) & 0xFu;
     pc = opcode & 0x0FFFu;
 }
 
@@ -117,27 +188,33 @@ void Chip8::OP_8xy0() {
     pc += 2;
 }
 
-// Vx OR Vy
+// Vx OR Vy. The VIP clobbers VF as a side effect
+template<class Quirks>
 void Chip8::OP_8xy1() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
     uint8_t Vy = (opcode & 0x00F0U) >> 4U;
     registers[Vx] |= registers[Vy];
+    if constexpr (Quirks::logicResetsVF) registers[0xF] = 0;
     pc += 2;
 }
 
-// Vx AND Vy
+// Vx AND Vy. The VIP clobbers VF as a side effect
+template<class Quirks>
 void Chip8::OP_8xy2() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
     uint8_t Vy = (opcode & 0x00F0U) >> 4U;
     registers[Vx] &= registers[Vy];
+    if constexpr (Quirks::logicResetsVF) registers[0xF] = 0;
     pc += 2;
 }
 
-// Vx XOR Vy
+// Vx XOR Vy. The VIP clobbers VF as a side effect
+template<class Quirks>
 void Chip8::OP_8xy3() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
     uint8_t Vy = (opcode & 0x00F0U) >> 4U;
     registers[Vx] ^= registers[Vy];
+    if constexpr (Quirks::logicResetsVF) registers[0xF] = 0;
     pc += 2;
 }
 
@@ -172,22 +249,18 @@ void Chip8::OP_8xy5() {
     pc += 2;
 }
 
-//void Chip8::OP_8xy6() {
-//    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-//    uint8_t Vy = (opcode & 0x00F0U) >> 4U;
-//    registers[0xF] = Vy & 0x1u;
-//    registers[Vx] = registers[Vy] >> 1u;
-//    pc += 2;
-//}
-
+// Shift right. The VIP shifts Vy into Vx, later interpreters shift Vx in place
+template<class Quirks>
 void Chip8::OP_8xy6()
 {
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t value = Quirks::shiftUsesVy ? registers[Vy] : registers[Vx];
 
     // Save LSB in VF
-    registers[0xF] = (registers[Vx] & 0x1u);
+    registers[0xF] = (value & 0x1u);
 
-    registers[Vx] >>= 1u;
+    registers[Vx] = value >> 1u;
     pc += 2;
 }
 
@@ -206,23 +279,18 @@ void Chip8::OP_8xy7() {
     pc += 2;
 }
 
-//void Chip8::OP_8xyE() {
-//    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-//    uint8_t Vy = (opcode & 0x00F0U) >> 4U;
-//    registers[0xF] = (Vy & 0x80u) >> 7U;
-//    registers[Vx] = registers[Vy] << 1u;
-//    pc += 2;
-//
-//}
-
+// Shift left, same Vx/Vy quirk as OP_8xy6
+template<class Quirks>
 void Chip8::OP_8xyE()
 {
     uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t value = Quirks::shiftUsesVy ? registers[Vy] : registers[Vx];
 
     // Save MSB in VF
-    registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
+    registers[0xF] = (value & 0x80u) >> 7u;
 
-    registers[Vx] <<= 1u;
+    registers[Vx] = value << 1u;
     pc += 2;
 }
 
@@ -243,8 +311,11 @@ void Chip8::OP_Annn() {
     pc += 2;
 }
 
+// Jump with offset. CHIP-48 and SCHIP read it as Bxnn and add Vx instead of V0
+template<class Quirks>
 void Chip8::OP_Bnnn() {
-    pc = (opcode & 0x0FFFu) + registers[0];
+    uint8_t Vx = Quirks::jumpUsesVx ? (opcode & 0x0F00U) >> 8U : 0;
+    pc = (opcode & 0x0FFFu) + registers[Vx];
 }
 
 void Chip8::OP_Cxkk() {
@@ -254,50 +325,64 @@ void Chip8::OP_Cxkk() {
     pc += 2;
 }
 
+bool Chip8::xorRow(unsigned int y, unsigned int x, uint64_t bits) {
+    uint64_t* row = video[y];
+    uint64_t left = x < 64 ? bits >> x : 0;
+    uint64_t right = x < 64 ? (x ? bits << (64 - x) : 0) : bits >> (x - 64);
+    // Low-res rows end after word 0, the rest of the sprite is clipped
+    if (!hires) right = 0;
+
+    bool erased = (row[0] & left) | (row[1] & right);
+    row[0] ^= left;
+    row[1] ^= right;
+    return erased;
+}
+
+// Draw an 8xN sprite from index. SCHIP draws 16x16 from 32 bytes for Dxy0.
+template<class Quirks>
 void Chip8::OP_Dxyn() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
     uint8_t Vy = (opcode & 0x00F0u) >> 4U;
     uint8_t N = opcode & 0x000FU;
 
-    // Wrap if going beyond screen boundaries
-    uint8_t xCoord = registers[Vx] % VIDEO_WIDTH;
-    uint8_t yCoord = registers[Vy] % VIDEO_HEIGHT;
-
-    registers[0xF] = 0;
-
-    for (unsigned int n_byte=0; n_byte<N; ++n_byte){
-        uint8_t byte_sprite = mem[index + n_byte];
-        for (unsigned int col=0; col<8; ++col){
-            uint8_t new_pix = byte_sprite & (0x80u >> col);
-            uint32_t* curr_pix = &video[(yCoord + n_byte) * VIDEO_WIDTH + xCoord + col];
-
-            if(new_pix){
-                if (*curr_pix == 0xFFFFFFFF)
-                {
-                    registers[0xF] = 1;
-                }
-                *curr_pix ^= 0xFFFFFFFF;
-            }
+    // Wrap the start position, clip the sprite at the right and bottom edges
+    const unsigned int rows = height();
+    unsigned int xCoord = registers[Vx] % width();
+    unsigned int yCoord = registers[Vy] % rows;
+
+    bool erased = false;
+    if (Quirks::superChip && N == 0) {
+        for (unsigned int n_row=0; n_row<16 && yCoord + n_row < rows; ++n_row){
+            uint64_t sprite = uint64_t(mem[(index + 2 * n_row) & (MEMORY_SIZE - 1)]) << 56 |
+                              uint64_t(mem[(index + 2 * n_row + 1) & (MEMORY_SIZE - 1)]) << 48;
+            erased |= xorRow(yCoord + n_row, xCoord, sprite);
         }
     }
+    else {
+        for (unsigned int n_byte=0; n_byte<N && yCoord + n_byte < rows; ++n_byte){
+            // Whole sprite row as one word aligned to the display row
+            erased |= xorRow(yCoord + n_byte, xCoord, uint64_t(mem[(index + n_byte) & (MEMORY_SIZE - 1)]) << 56);
+        }
+    }
+    registers[0xF] = erased;
     drawFlag = true;
     pc += 2;
 }
 
 void Chip8::OP_Ex9E() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-    uint8_t key = registers[Vx];
+    uint8_t key = registers[Vx] & 0xFu;
 
-    if (keypad[key]) pc += 4;
+    if (keypad & (1u << key)) pc += 4;
     else pc += 2;
 
 }
 
 void Chip8::OP_ExA1() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-    uint8_t key = registers[Vx];
+    uint8_t key = registers[Vx] & 0xFu;
 
-    if (!keypad[key]) pc += 4;
+    if (!(keypad & (1u << key))) pc += 4;
     else pc += 2;
 }
 
@@ -309,87 +394,13 @@ void Chip8::OP_Fx07() {
 
 }
 
+// Wait for a key. The lowest pressed key wins
 void Chip8::OP_Fx0A() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
 
-    if (keypad[0])
-    {
-        registers[Vx] = 0;
-        pc += 2;
-    }
-    else if (keypad[1])
-    {
-        registers[Vx] = 1;
-        pc += 2;
-    }
-    else if (keypad[2])
-    {
-        registers[Vx] = 2;
-        pc += 2;
-    }
-    else if (keypad[3])
-    {
-        registers[Vx] = 3;
-        pc += 2;
-    }
-    else if (keypad[4])
-    {
-        registers[Vx] = 4;
-        pc += 2;
-    }
-    else if (keypad[5])
-    {
-        registers[Vx] = 5;
-        pc += 2;
-    }
-    else if (keypad[6])
-    {
-        registers[Vx] = 6;
-        pc += 2;
-    }
-    else if (keypad[7])
-    {
-        registers[Vx] = 7;
-        pc += 2;
-    }
-    else if (keypad[8])
-    {
-        registers[Vx] = 8;
-        pc += 2;
-    }
-    else if (keypad[9])
-    {
-        registers[Vx] = 9;
-        pc += 2;
-    }
-    else if (keypad[10])
-    {
-        registers[Vx] = 10;
-        pc += 2;
-    }
-    else if (keypad[11])
-    {
-        registers[Vx] = 11;
-        pc += 2;
-    }
-    else if (keypad[12])
-    {
-        registers[Vx] = 12;
-        pc += 2;
-    }
-    else if (keypad[13])
+    if (keypad)
     {
-        registers[Vx] = 13;
-        pc += 2;
-    }
-    else if (keypad[14])
-    {
-        registers[Vx] = 14;
-        pc += 2;
-    }
-    else if (keypad[15])
-    {
-        registers[Vx] = 15;
+        registers[Vx] = __builtin_ctz(keypad);
         pc += 2;
     }
     else
@@ -431,171 +442,401 @@ void Chip8::OP_Fx29() {
 
 void Chip8::OP_Fx33() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-    mem[index] =   (registers[Vx] / 100) % 10;
-    mem[index+1] = (registers[Vx] / 10)  % 10;
-    mem[index+2] =  registers[Vx] % 10;
+    mem[index & (MEMORY_SIZE - 1)] =       (registers[Vx] / 100) % 10;
+    mem[(index+1) & (MEMORY_SIZE - 1)] = (registers[Vx] / 10)  % 10;
+    mem[(index+2) & (MEMORY_SIZE - 1)] =  registers[Vx] % 10;
+    touchMem();
     pc += 2;
 
 }
 
+// Store V0..Vx at index. The profile decides whether index advances
+template<class Quirks>
 void Chip8::OP_Fx55() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-    for (unsigned int i=0; i<=Vx; ++i) mem[index + i] = registers[i];
-//    index += Vx + 1;
+    for (unsigned int i=0; i<=Vx; ++i) mem[(index + i) & (MEMORY_SIZE - 1)] = registers[i];
+    touchMem();
+    if constexpr (Quirks::loadStoreIndex == quirks::INDEX_PLUS_X1) index += Vx + 1;
+    else if constexpr (Quirks::loadStoreIndex == quirks::INDEX_PLUS_X) index += Vx;
     pc += 2;
 }
 
+// Load V0..Vx from index, same index quirk as OP_Fx55
+template<class Quirks>
 void Chip8::OP_Fx65() {
     uint8_t Vx = (opcode & 0x0F00U) >> 8U;
-    for (unsigned int i=0; i<=Vx; ++i) registers[i] = mem[index + i];
-//    index += Vx + 1;
+    for (unsigned int i=0; i<=Vx; ++i) registers[i] = mem[(index + i) & (MEMORY_SIZE - 1)];
+    if constexpr (Quirks::loadStoreIndex == quirks::INDEX_PLUS_X1) index += Vx + 1;
+    else if constexpr (Quirks::loadStoreIndex == quirks::INDEX_PLUS_X) index += Vx;
     pc += 2;
 }
 
-void Chip8::run() {
-    opcode = uint16_t(mem[pc] << 8) | uint16_t(mem[pc+1]);
-//    printf("0x%04X\n", mem[pc + 1] << 8);
-//    printf("0x%04X\n", mem[pc]);
-    printf("opcode = 0x%04X\n", opcode);
-//    printf("pc = 0x%X\n", pc);
+// Scroll down n rows of the current mode
+void Chip8::OP_00Cn() {
+    const unsigned int rows = height();
+    const unsigned int n = std::min<unsigned int>(opcode & 0x000Fu, rows);
+    std::memmove(video[n], video[0], (rows - n) * sizeof(video[0]));
+    std::memset(video[0], 0, n * sizeof(video[0]));
+    drawFlag = true;
+    pc += 2;
+}
 
-    switch(opcode & 0xF000u){
-        case 0x1000:
-            OP_1nnn();
-            break;
-        case 0x2000:
-            OP_2nnn();
-            break;
-        case 0x3000:
-            OP_3xkk();
-            break;
-        case 0x4000:
-            OP_4xkk();
-            break;
-        case 0x5000:
-            OP_5xy0();
-            break;
-        case 0x6000:
-            OP_6xkk();
-            break;
-        case 0x7000:
-            OP_7xkk();
-            break;
-        case 0x9000:
-            OP_9xy0();
-            break;
-        case 0xA000:
-            OP_Annn();
-            break;
-        case 0xB000:
-            OP_Bnnn();
-            break;
-        case 0xC000:
-            OP_Cxkk();
-            break;
-        case 0xD000:
-            OP_Dxyn();
+// Scroll right 4 pixels: each row shifts as one 128-bit value
+void Chip8::OP_00FB() {
+    const unsigned int rows = height();
+#ifdef __SSE2__
+    // Low-res pixels shifted past column 63 fall off the display
+    const __m128i keep = _mm_set_epi64x(hires ? -1 : 0, -1);
+    for (unsigned int y=0; y<rows; ++y) {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(video[y]));
+        __m128i carry = _mm_slli_epi64(_mm_slli_si128(row, 8), 60);
+        row = _mm_or_si128(_mm_srli_epi64(row, 4), carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(video[y]), _mm_and_si128(row, keep));
+    }
+#else
+    for (unsigned int y=0; y<rows; ++y) {
+        video[y][1] = hires ? (video[y][1] >> 4) | (video[y][0] << 60) : 0;
+        video[y][0] >>= 4;
+    }
+#endif
+    drawFlag = true;
+    pc += 2;
+}
+
+// Scroll left 4 pixels
+void Chip8::OP_00FC() {
+    const unsigned int rows = height();
+#ifdef __SSE2__
+    for (unsigned int y=0; y<rows; ++y) {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(video[y]));
+        __m128i carry = _mm_srli_epi64(_mm_srli_si128(row, 8), 60);
+        row = _mm_or_si128(_mm_slli_epi64(row, 4), carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(video[y]), row);
+    }
+#else
+    for (unsigned int y=0; y<rows; ++y) {
+        video[y][0] = (video[y][0] << 4) | (video[y][1] >> 60);
+        video[y][1] <<= 4;
+    }
+#endif
+    drawFlag = true;
+    pc += 2;
+}
+
+// Exit the interpreter: stay on this instruction
+void Chip8::OP_00FD() {
+}
+
+// Low-res mode. The display is cleared on every mode switch.
+void Chip8::OP_00FE() {
+    hires = false;
+    OP_00E0();
+}
+
+// Hi-res mode
+void Chip8::OP_00FF() {
+    hires = true;
+    OP_00E0();
+}
+
+// Point index at the 8x10 digit Vx
+void Chip8::OP_Fx30() {
+    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
+    index = BIG_FONT_ADDRESS + (registers[Vx] % 10) * 10;
+    pc += 2;
+}
+
+// Save V0..Vx to the RPL flags
+void Chip8::OP_Fx75() {
+    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
+    std::memcpy(flags, registers, Vx + 1);
+    pc += 2;
+}
+
+// Restore V0..Vx from the RPL flags
+void Chip8::OP_Fx85() {
+    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
+    std::memcpy(registers, flags, Vx + 1);
+    pc += 2;
+}
+
+void Chip8::OP_superChip() {
+    if ((opcode & 0xF000u) == 0xF000u) {
+        switch (opcode & 0x00FFu) {
+            case 0x0030:
+                OP_Fx30();
+                break;
+            case 0x0075:
+                OP_Fx75();
+                break;
+            case 0x0085:
+                OP_Fx85();
+                break;
+            default:
+                pc += 2;
+                break;
+        }
+        return;
+    }
+
+    switch (opcode & 0x00FFu) {
+        case 0x00FB:
+            OP_00FB();
             break;
-        case 0x8000:
-            switch (opcode & 0x000Fu) {
-                case 0x0000:
-                    OP_8xy0();
-                    break;
-                case 0x0001:
-                    OP_8xy1();
-                    break;
-                case 0x0002:
-                    OP_8xy2();
-                    break;
-                case 0x0003:
-                    OP_8xy3();
-                    break;
-                case 0x0004:
-                    OP_8xy4();
-                    break;
-                case 0x0005:
-                    OP_8xy5();
-                    break;
-                case 0x0006:
-                    OP_8xy6();
-                    break;
-                case 0x0007:
-                    OP_8xy7();
-                    break;
-                case 0x000E:
-                    OP_8xyE();
-                    break;
-                default:
-                    pc += 2;
-                    break;
-            }
+        case 0x00FC:
+            OP_00FC();
             break;
-        case 0x0000:
-            switch (opcode & 0x00FFu) {
-                case 0x00E0:
-                    OP_00E0();
-                    break;
-                case 0x00EE:
-                    OP_00EE();
-                    break;
-                default:
-                    pc += 2;
-                    break;
-            }
+        case 0x00FD:
+            OP_00FD();
             break;
-        case 0xE000:
-            switch (opcode & 0x00FFu) {
-                case 0x00A1:
-                    OP_ExA1();
-                    break;
-                case 0x009E:
-                    OP_Ex9E();
-                    break;
-                default:
-                    pc += 2;
-                    break;
-            }
+        case 0x00FE:
+            OP_00FE();
             break;
-        case 0xF000:
-            switch (opcode & 0x00FFu) {
-                case 0x0007:
-                    OP_Fx07();
-                    break;
-                case 0x000A:
-                    OP_Fx0A();
-                    break;
-                case 0x0015:
-                    OP_Fx15();
-                    break;
-                case 0x0018:
-                    OP_Fx18();
-                    break;
-                case 0x001E:
-                    OP_Fx1E();
-                    break;
-                case 0x0029:
-                    OP_Fx29();
-                    break;
-                case 0x0033:
-                    OP_Fx33();
-                    break;
-                case 0x0055:
-                    OP_Fx55();
-                    break;
-                case 0x0065:
-                    OP_Fx65();
-                    break;
-                default:
-                    pc += 2;
-                    break;
-            }
+        case 0x00FF:
+            OP_00FF();
             break;
         default:
-            printf("Unknown opcode 0x%X\n", opcode);
-            pc += 2;
+            if ((opcode & 0x00F0u) == 0x00C0u) OP_00Cn();
+            else pc += 2;
             break;
     }
+}
+
+template<class Quirks, bool Debug, bool TickTimers>
+void Chip8::execute(unsigned int cycles) {
+    for (unsigned int cycle=0; cycle<cycles; ++cycle) {
+        if constexpr (Debug) {
+            if (debugger && debugger->shouldBreak(*this)) return;
+        }
+
+        opcode = uint16_t(mem[pc & (MEMORY_SIZE - 1)] << 8) | uint16_t(mem[(pc + 1) & (MEMORY_SIZE - 1)]);
+
+        if constexpr (Debug) {
+            if (debugger && debugger->trace) printf("pc = 0x%03X opcode = 0x%04X\n", pc, opcode);
+        }
+
+        switch(opcode & 0xF000u){
+            case 0x1000:
+                OP_1nnn();
+                break;
+            case 0x2000:
+                OP_2nnn();
+                break;
+            case 0x3000:
+                OP_3xkk();
+                break;
+            case 0x4000:
+                OP_4xkk();
+                break;
+            case 0x5000:
+                OP_5xy0();
+                break;
+            case 0x6000:
+                OP_6xkk();
+                break;
+            case 0x7000:
+                OP_7xkk();
+                break;
+            case 0x9000:
+                OP_9xy0();
+                break;
+            case 0xA000:
+                OP_Annn();
+                break;
+            case 0xB000:
+                OP_Bnnn<Quirks>();
+                break;
+            case 0xC000:
+                OP_Cxkk();
+                break;
+            case 0xD000:
+                OP_Dxyn<Quirks>();
+                break;
+            case 0x8000:
+                switch (opcode & 0x000Fu) {
+                    case 0x0000:
+                        OP_8xy0();
+                        break;
+                    case 0x0001:
+                        OP_8xy1<Quirks>();
+                        break;
+                    case 0x0002:
+                        OP_8xy2<Quirks>();
+                        break;
+                    case 0x0003:
+                        OP_8xy3<Quirks>();
+                        break;
+                    case 0x0004:
+                        OP_8xy4();
+                        break;
+                    case 0x0005:
+                        OP_8xy5();
+                        break;
+                    case 0x0006:
+                        OP_8xy6<Quirks>();
+                        break;
+                    case 0x0007:
+                        OP_8xy7();
+                        break;
+                    case 0x000E:
+                        OP_8xyE<Quirks>();
+                        break;
+                    default:
+                        pc += 2;
+                        break;
+                }
+                break;
+            case 0x0000:
+                switch (opcode & 0x00FFu) {
+                    case 0x00E0:
+                        OP_00E0();
+                        break;
+                    case 0x00EE:
+                        OP_00EE();
+                        break;
+                    default:
+                        if constexpr (Quirks::superChip) OP_superChip();
+                        else pc += 2;
+                        break;
+                }
+                break;
+            case 0xE000:
+                switch (opcode & 0x00FFu) {
+                    case 0x00A1:
+                        OP_ExA1();
+                        break;
+                    case 0x009E:
+                        OP_Ex9E();
+                        break;
+                    default:
+                        pc += 2;
+                        break;
+                }
+                break;
+            case 0xF000:
+                switch (opcode & 0x00FFu) {
+                    case 0x0007:
+                        OP_Fx07();
+                        break;
+                    case 0x000A:
+                        OP_Fx0A();
+                        break;
+                    case 0x0015:
+                        OP_Fx15();
+                        break;
+                    case 0x0018:
+                        OP_Fx18();
+                        break;
+                    case 0x001E:
+                        OP_Fx1E();
+                        break;
+                    case 0x0029:
+                        OP_Fx29();
+                        break;
+                    case 0x0033:
+                        OP_Fx33();
+                        break;
+                    case 0x0055:
+                        OP_Fx55<Quirks>();
+                        break;
+                    case 0x0065:
+                        OP_Fx65<Quirks>();
+                        break;
+                    default:
+                        if constexpr (Quirks::superChip) OP_superChip();
+                        else pc += 2;
+                        break;
+                }
+                break;
+            default:
+                printf("Unknown opcode 0x%X\n", opcode);
+                pc += 2;
+                break;
+        }
+
+        if constexpr (TickTimers) tickTimers();
+    }
+}
 
-    if (delayTimer > 0) delayTimer--;
-    if (soundTimer > 0) soundTimer--;
+
+// Handler tables for executeTable(), indexed by the opcode nibble/byte that
+// selects the instruction inside each group
+template<class Quirks>
+struct DispatchTable {
+    using Handler = void (Chip8::*)();
+    using ByteTable = std::array<Handler, 256>;
+
+    static constexpr Handler main[16] = {
+            &Chip8::OP_0group<Quirks>, &Chip8::OP_1nnn, &Chip8::OP_2nnn, &Chip8::OP_3xkk,
+            &Chip8::OP_4xkk, &Chip8::OP_5xy0, &Chip8::OP_6xkk, &Chip8::OP_7xkk,
+            &Chip8::OP_8group<Quirks>, &Chip8::OP_9xy0, &Chip8::OP_Annn, &Chip8::OP_Bnnn<Quirks>,
+            &Chip8::OP_Cxkk, &Chip8::OP_Dxyn<Quirks>, &Chip8::OP_Egroup<Quirks>, &Chip8::OP_Fgroup<Quirks>
+    };
+
+    static constexpr Handler arithmetic[16] = {
+            &Chip8::OP_8xy0, &Chip8::OP_8xy1<Quirks>, &Chip8::OP_8xy2<Quirks>, &Chip8::OP_8xy3<Quirks>,
+            &Chip8::OP_8xy4, &Chip8::OP_8xy5, &Chip8::OP_8xy6<Quirks>, &Chip8::OP_8xy7,
+            &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+            &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_8xyE<Quirks>, &Chip8::OP_NULL
+    };
+
+    static constexpr ByteTable byteTable(std::initializer_list<std::pair<uint8_t, Handler>> entries) {
+        ByteTable table{};
+        for (unsigned int i=0; i<table.size(); ++i) table[i] = &Chip8::OP_NULL;
+        for (const auto& entry : entries) table[entry.first] = entry.second;
+        return table;
+    }
+
+    static constexpr ByteTable system = Quirks::superChip ? byteTable({
+            {0xC0, &Chip8::OP_00Cn}, {0xC1, &Chip8::OP_00Cn}, {0xC2, &Chip8::OP_00Cn}, {0xC3, &Chip8::OP_00Cn},
+            {0xC4, &Chip8::OP_00Cn}, {0xC5, &Chip8::OP_00Cn}, {0xC6, &Chip8::OP_00Cn}, {0xC7, &Chip8::OP_00Cn},
+            {0xC8, &Chip8::OP_00Cn}, {0xC9, &Chip8::OP_00Cn}, {0xCA, &Chip8::OP_00Cn}, {0xCB, &Chip8::OP_00Cn},
+            {0xCC, &Chip8::OP_00Cn}, {0xCD, &Chip8::OP_00Cn}, {0xCE, &Chip8::OP_00Cn}, {0xCF, &Chip8::OP_00Cn},
+            {0xE0, &Chip8::OP_00E0}, {0xEE, &Chip8::OP_00EE}, {0xFB, &Chip8::OP_00FB}, {0xFC, &Chip8::OP_00FC},
+            {0xFD, &Chip8::OP_00FD}, {0xFE, &Chip8::OP_00FE}, {0xFF, &Chip8::OP_00FF}
+    }) : byteTable({
+            {0xE0, &Chip8::OP_00E0}, {0xEE, &Chip8::OP_00EE}
+    });
+
+    static constexpr ByteTable keys = byteTable({
+            {0x9E, &Chip8::OP_Ex9E}, {0xA1, &Chip8::OP_ExA1}
+    });
+
+    static constexpr ByteTable misc = byteTable({
+            {0x07, &Chip8::OP_Fx07}, {0x0A, &Chip8::OP_Fx0A}, {0x15, &Chip8::OP_Fx15},
+            {0x18, &Chip8::OP_Fx18}, {0x1E, &Chip8::OP_Fx1E}, {0x29, &Chip8::OP_Fx29},
+            {0x33, &Chip8::OP_Fx33}, {0x55, &Chip8::OP_Fx55<Quirks>}, {0x65, &Chip8::OP_Fx65<Quirks>},
+            {0x30, Quirks::superChip ? &Chip8::OP_Fx30 : &Chip8::OP_NULL},
+            {0x75, Quirks::superChip ? &Chip8::OP_Fx75 : &Chip8::OP_NULL},
+            {0x85, Quirks::superChip ? &Chip8::OP_Fx85 : &Chip8::OP_NULL}
+    });
+};
+
+template<class Quirks>
+void Chip8::OP_0group() {
+    (this->*DispatchTable<Quirks>::system[opcode & 0x00FFu])();
+}
+
+template<class Quirks>
+void Chip8::OP_8group() {
+    (this->*DispatchTable<Quirks>::arithmetic[opcode & 0x000Fu])();
+}
+
+template<class Quirks>
+void Chip8::OP_Egroup() {
+    (this->*DispatchTable<Quirks>::keys[opcode & 0x00FFu])();
+}
+
+template<class Quirks>
+void Chip8::OP_Fgroup() {
+    (this->*DispatchTable<Quirks>::misc[opcode & 0x00FFu])();
+}
+
+template<class Quirks, bool TickTimers>
+void Chip8::executeTable(unsigned int cycles) {
+    for (unsigned int cycle=0; cycle<cycles; ++cycle) {
+        opcode = uint16_t(mem[pc & (MEMORY_SIZE - 1)] << 8) | uint16_t(mem[(pc + 1) & (MEMORY_SIZE - 1)]);
+        (this->*DispatchTable<Quirks>::main[opcode >> 12u])();
+        if constexpr (TickTimers) tickTimers();
+    }
 }
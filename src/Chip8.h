@@ -1,24 +1,89 @@
+#pragma once
+
 #include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <chrono>
 #include <random>
 #include <cstring>
-#include "SDL.h"
+
+class Debugger;
 
 
+// Every mem access wraps at MEMORY_SIZE, so any ROM stays inside the array
+const unsigned int MEMORY_SIZE = 4096;
+static_assert((MEMORY_SIZE & (MEMORY_SIZE - 1)) == 0, "addresses are wrapped with a mask");
 const unsigned int START_ADDRESS = 0x200;
 const unsigned int FONT_ADDRESS = 0x50;
 const unsigned int FONTSET_SIZE = 80;
-const int VIDEO_WIDTH = 64;
-const int VIDEO_HEIGHT = 32;
+const unsigned int BIG_FONT_ADDRESS = FONT_ADDRESS + FONTSET_SIZE;
+const unsigned int BIG_FONTSET_SIZE = 100;
+// Display frame: the SCHIP hi-res resolution. Low-res pixels cover 2x2 of it.
+const int VIDEO_WIDTH = 128;
+const int VIDEO_HEIGHT = 64;
+const int LORES_WIDTH = 64;
+const int LORES_HEIGHT = 32;
+static_assert(VIDEO_WIDTH == 128, "display rows are stored as two 64-bit words");
+// Instructions per 60 Hz frame for Chip8::runFrame()
+const unsigned int CYCLES_PER_FRAME = 10;
+
+// Interpreter variants whose instruction semantics differ
+enum class Profile : uint8_t { Modern, CosmacVip, Chip48, SuperChip };
+
+// Profile named on a command line: vip, chip48 or schip, Modern otherwise
+inline Profile profileFromName(const char* name) {
+    if (!std::strcmp(name, "vip")) return Profile::CosmacVip;
+    if (!std::strcmp(name, "chip48")) return Profile::Chip48;
+    if (!std::strcmp(name, "schip")) return Profile::SuperChip;
+    return Profile::Modern;
+}
+
+// Compile-time quirk policies, one per Profile
+namespace quirks {
+    // How Fx55/Fx65 leave index afterwards
+    enum IndexMode : uint8_t { INDEX_UNCHANGED, INDEX_PLUS_X, INDEX_PLUS_X1 };
+
+    // Behaviour this interpreter always had: shift Vx in place, index unchanged
+    struct Modern {
+        static constexpr bool shiftUsesVy = false;
+        static constexpr IndexMode loadStoreIndex = INDEX_UNCHANGED;
+        static constexpr bool jumpUsesVx = false;
+        static constexpr bool logicResetsVF = false;
+        static constexpr bool superChip = false;
+    };
+
+    struct CosmacVip {
+        static constexpr bool shiftUsesVy = true;
+        static constexpr IndexMode loadStoreIndex = INDEX_PLUS_X1;
+        static constexpr bool jumpUsesVx = false;
+        static constexpr bool logicResetsVF = true;
+        static constexpr bool superChip = false;
+    };
+
+    struct Chip48 {
+        static constexpr bool shiftUsesVy = false;
+        static constexpr IndexMode loadStoreIndex = INDEX_PLUS_X;
+        static constexpr bool jumpUsesVx = true;
+        static constexpr bool logicResetsVF = false;
+        static constexpr bool superChip = false;
+    };
+
+    struct SuperChip {
+        static constexpr bool shiftUsesVy = false;
+        static constexpr IndexMode loadStoreIndex = INDEX_UNCHANGED;
+        static constexpr bool jumpUsesVx = true;
+        static constexpr bool logicResetsVF = false;
+        static constexpr bool superChip = true;
+    };
+}
 
 class Chip8{
 public:
 
     Chip8();
 
-    uint8_t fontset[FONTSET_SIZE] =
+    // Shared by every instance, copied into mem at FONT_ADDRESS on reset
+    static constexpr uint8_t fontset[FONTSET_SIZE] =
             {
                     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
                     0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -38,26 +103,111 @@ public:
                     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
             };
 
-    uint8_t registers[16]{};
-    uint8_t mem[4096]{};
-    uint16_t index{};
+    // SCHIP 8x10 digits for Fx30, copied to BIG_FONT_ADDRESS
+    static constexpr uint8_t bigFontset[BIG_FONTSET_SIZE] =
+            {
+                    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+                    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+                    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+                    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+                    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+                    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+                    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+                    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+                    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+                    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C  // 9
+            };
+
+    // Hot state, read or written by nearly every instruction. Kept together in
+    // the first cache line of the object, with no padding.
+    alignas(64) uint8_t registers[16]{};
     uint16_t pc{};
-    uint16_t stack[16]{};
+    uint16_t index{};
+    uint16_t opcode{};
+    uint16_t keypad{};  // Bit i is set while key i is held
     uint8_t sp{};
     uint8_t delayTimer{};
     uint8_t soundTimer{};
-    uint8_t keypad[16]{};
-    uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
-    uint16_t opcode{};
-    bool drawFlag;
+    bool drawFlag{};
+    uint16_t stack[16]{};
+    Profile profile{};
+    bool hires{};       // SCHIP 128x64 mode
+    uint8_t reserved[2]{};
 
+    alignas(64) uint8_t mem[MEMORY_SIZE]{};
+    // Two words per row, bit 63 of word 0 is the leftmost pixel. Low-res
+    // mode only uses word 0 of the first LORES_HEIGHT rows.
+    uint64_t video[VIDEO_HEIGHT][2]{};
+    // SCHIP RPL user flags (Fx75/Fx85), kept across reset()
+    uint8_t flags[16]{};
+
+    // Cold state, touched by few instructions or only between runs
     std::default_random_engine randGen;
     std::uniform_int_distribution<uint8_t> randByte;
+    // Changes whenever mem is written, so mem-derived data (hashes) can be
+    // reused while it stays the same. Never reused within the process, so
+    // equal epochs mean equal mem, also across copies. Code that writes mem
+    // directly must call touchMem().
+    uint64_t memEpoch{};
+    void touchMem() { memEpoch = nextMemEpoch(); }
+    static uint64_t nextMemEpoch();
+
+    // Attached debugger, only consulted by run<true>()
+    Debugger* debugger{};
+
+    // Execute `cycles` instructions with the loop specialised for the current
+    // profile. The debug specialisation checks breakpoints and watchpoints
+    // before each instruction; run<false>() compiles them out entirely.
+    template<bool Debug = false>
+    void run(unsigned int cycles = 1) { (this->*(Debug ? debugStep : step))(cycles); }
+    // Same semantics as run<false>(), dispatching through handler tables
+    // instead of the switch. Kept so the two can be checked against each other.
+    void runTable(unsigned int cycles = 1) { (this->*tableStep)(cycles); }
+    // The same loops leaving the timers alone, for callers that tick them per frame
+    template<bool Debug = false>
+    void runUntimed(unsigned int cycles) { (this->*(Debug ? untimedDebugStep : untimedStep))(cycles); }
+    void runTableUntimed(unsigned int cycles) { (this->*untimedTableStep)(cycles); }
+    // One 60 Hz frame: `cycles` instructions, then the timers tick once. run()
+    // ticks them after every instruction, which is what the SDL loop paces.
+    void runFrame(unsigned int cycles = CYCLES_PER_FRAME) {
+        runUntimed(cycles);
+        tickTimers();
+    }
+    void tickTimers() {
+        if (delayTimer > 0) delayTimer--;
+        if (soundTimer > 0) soundTimer--;
+    }
 
-    void run();
-    void loadRom(char const *filename);
+    bool loadRom(char const *filename, Profile romProfile = Profile::Modern);
+    bool loadRom(const uint8_t* data, size_t size, Profile romProfile = Profile::Modern);
+    void reset();
+    void setProfile(Profile newProfile);
+    // Reseed Cxkk's generator so runs can be reproduced
+    void seed(uint32_t value);
+
+    // Architectural state (hot line, mem, video and flags) is one contiguous block
+    const uint8_t* stateData() const { return registers; }
+    uint8_t* stateData() { return registers; }
+    size_t stateSize() const { return reinterpret_cast<const uint8_t*>(flags + sizeof(flags)) - registers; }
+
+    void setKey(unsigned int key, bool pressed) {
+        if (pressed) keypad |= 1u << key;
+        else keypad &= ~(1u << key);
+    }
+    // Resolution of the current mode
+    int width() const { return hires ? VIDEO_WIDTH : LORES_WIDTH; }
+    int height() const { return hires ? VIDEO_HEIGHT : LORES_HEIGHT; }
+    // Pixel of the VIDEO_WIDTH x VIDEO_HEIGHT frame, whatever the mode
+    bool pixel(int x, int y) const {
+        if (!hires) {
+            x >>= 1;
+            y >>= 1;
+        }
+        return (video[y][x >> 6] >> (63 - (x & 63))) & 1u;
+    }
 
     //Instructions
+    void OP_NULL();
     void OP_00E0();
     void OP_00EE();
     void OP_1nnn();
@@ -68,19 +218,19 @@ public:
     void OP_6xkk();
     void OP_7xkk();
     void OP_8xy0();
-    void OP_8xy1();
-    void OP_8xy2();
-    void OP_8xy3();
+    template<class Quirks> void OP_8xy1();
+    template<class Quirks> void OP_8xy2();
+    template<class Quirks> void OP_8xy3();
     void OP_8xy4();
     void OP_8xy5();
-    void OP_8xy6();
+    template<class Quirks> void OP_8xy6();
     void OP_8xy7();
-    void OP_8xyE();
+    template<class Quirks> void OP_8xyE();
     void OP_9xy0();
     void OP_Annn();
-    void OP_Bnnn();
+    template<class Quirks> void OP_Bnnn();
     void OP_Cxkk();
-    void OP_Dxyn();
+    template<class Quirks> void OP_Dxyn();
     void OP_Ex9E();
     void OP_ExA1();
     void OP_Fx07();
@@ -90,6 +240,43 @@ public:
     void OP_Fx1E();
     void OP_Fx29();
     void OP_Fx33();
-    void OP_Fx55();
-    void OP_Fx65();
+    template<class Quirks> void OP_Fx55();
+    template<class Quirks> void OP_Fx65();
+
+    // SUPER-CHIP, only dispatched for profiles with Quirks::superChip
+    void OP_00Cn();
+    void OP_00FB();
+    void OP_00FC();
+    void OP_00FD();
+    void OP_00FE();
+    void OP_00FF();
+    void OP_Fx30();
+    void OP_Fx75();
+    void OP_Fx85();
+    // The SCHIP additions to the 0 and F groups, for the switch loop
+    void OP_superChip();
+    // XOR a left-aligned sprite row into display row y at column x. True if
+    // it erased a lit pixel.
+    bool xorRow(unsigned int y, unsigned int x, uint64_t bits);
+
+    // Second-level dispatch for runTable()
+    template<class Quirks> void OP_0group();
+    template<class Quirks> void OP_8group();
+    template<class Quirks> void OP_Egroup();
+    template<class Quirks> void OP_Fgroup();
+
+    // Run loops for the current profile, selected by setProfile()
+    using StepFn = void (Chip8::*)(unsigned int);
+    StepFn step{};
+    StepFn debugStep{};
+    StepFn tableStep{};
+    StepFn untimedStep{};
+    StepFn untimedDebugStep{};
+    StepFn untimedTableStep{};
+
+    template<class Quirks> void selectLoops();
+    template<class Quirks, bool Debug, bool TickTimers = true>
+    void execute(unsigned int cycles);
+    template<class Quirks, bool TickTimers = true>
+    void executeTable(unsigned int cycles);
 };
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "Debugger.h"
+
+
+void Debugger::addBreakpoint(uint16_t addr) {
+    addr &= MEMORY_SIZE - 1;
+    unconditional.set(addr);
+    pcMask.set(addr);
+}
+
+void Debugger::addConditionalBreakpoint(uint16_t addr, uint8_t reg, Compare cmp, uint8_t value) {
+    addr &= MEMORY_SIZE - 1;
+    conditions.push_back({addr, uint8_t(reg & 0xFu), cmp, value});
+    pcMask.set(addr);
+}
+
+void Debugger::removeBreakpoint(uint16_t addr) {
+    addr &= MEMORY_SIZE - 1;
+    unconditional.reset(addr);
+    pcMask.reset(addr);
+    for (auto it = conditions.begin(); it != conditions.end();) {
+        if (it->addr == addr) it = conditions.erase(it);
+        else ++it;
+    }
+}
+
+void Debugger::addWatchpoint(uint16_t begin, uint16_t end, uint8_t kind) {
+    for (unsigned int addr = begin; addr < end && addr < MEMORY_SIZE; ++addr) {
+        if (kind & WATCH_READ) readMask.set(addr);
+        if (kind & WATCH_WRITE) writeMask.set(addr);
+    }
+    watching = readMask.any() || writeMask.any();
+}
+
+void Debugger::clearWatchpoints() {
+    readMask.reset();
+    writeMask.reset();
+    watching = false;
+}
+
+bool Debugger::shouldBreak(const Chip8& emu) {
+    if (stopped()) return true;
+    if (skipOnce) {
+        skipOnce = false;
+        return false;
+    }
+
+    if (pcMask[emu.pc & (MEMORY_SIZE - 1)] && hitBreakpoint(emu)) {
+        reason = StopReason::Breakpoint;
+        stopPc = emu.pc;
+        return true;
+    }
+    if (watching && hitWatchpoint(emu)) {
+        reason = StopReason::Watchpoint;
+        stopPc = emu.pc;
+        return true;
+    }
+    return false;
+}
+
+void Debugger::resume() {
+    if (!stopped()) return;
+    reason = StopReason::None;
+    // Let the instruction we stopped on execute before checking again
+    skipOnce = true;
+}
+
+bool Debugger::hitBreakpoint(const Chip8& emu) const {
+    if (unconditional[emu.pc & (MEMORY_SIZE - 1)]) return true;
+
+    for (const Condition& c : conditions) {
+        if (c.addr != (emu.pc & (MEMORY_SIZE - 1))) continue;
+        uint8_t v = emu.registers[c.reg];
+        switch (c.cmp) {
+            case Compare::Eq: if (v == c.value) return true; break;
+            case Compare::Ne: if (v != c.value) return true; break;
+            case Compare::Lt: if (v <  c.value) return true; break;
+            case Compare::Le: if (v <= c.value) return true; break;
+            case Compare::Gt: if (v >  c.value) return true; break;
+            case Compare::Ge: if (v >= c.value) return true; break;
+        }
+    }
+    return false;
+}
+
+// Decode the pending instruction and test the bytes it will touch. Only the
+// opcodes that address mem through index are considered.
+bool Debugger::hitWatchpoint(const Chip8& emu) {
+    uint16_t opcode = uint16_t(emu.mem[emu.pc & (MEMORY_SIZE - 1)] << 8) | uint16_t(emu.mem[(emu.pc + 1) & (MEMORY_SIZE - 1)]);
+    uint8_t Vx = (opcode & 0x0F00U) >> 8U;
+
+    const std::bitset<MEMORY_SIZE>* mask = nullptr;
+    unsigned int length = 0;
+
+    if ((opcode & 0xF000u) == 0xD000u) {
+        mask = &readMask;
+        length = opcode & 0x000FU;
+        if (!length && emu.profile == Profile::SuperChip) length = 32;  // 16x16 sprite
+    } else if ((opcode & 0xF0FFu) == 0xF033u) {
+        mask = &writeMask;
+        length = 3;
+    } else if ((opcode & 0xF0FFu) == 0xF055u) {
+        mask = &writeMask;
+        length = Vx + 1;
+    } else if ((opcode & 0xF0FFu) == 0xF065u) {
+        mask = &readMask;
+        length = Vx + 1;
+    } else {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < length; ++i) {
+        unsigned int addr = (emu.index + i) & (MEMORY_SIZE - 1);
+        if ((*mask)[addr]) {
+            stopAddr = addr;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "Chip8.h"
+
+enum class Compare : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+
+enum WatchKind : uint8_t {
+    WATCH_READ = 1,
+    WATCH_WRITE = 2,
+    WATCH_READ_WRITE = WATCH_READ | WATCH_WRITE
+};
+
+enum class StopReason : uint8_t { None, Breakpoint, Watchpoint };
+
+// Breakpoints and watchpoints consulted by Chip8::run<true>() before every
+// instruction. All breakpoint addresses share one bitmap so the common case is
+// a single bit test; watchpoints are only decoded for the memory opcodes.
+class Debugger {
+public:
+    void addBreakpoint(uint16_t addr);
+    // Stop at addr only when V[reg] <cmp> value holds
+    void addConditionalBreakpoint(uint16_t addr, uint8_t reg, Compare cmp, uint8_t value);
+    void removeBreakpoint(uint16_t addr);
+
+    // Watch mem[begin, end) for the given kind of access
+    void addWatchpoint(uint16_t begin, uint16_t end, uint8_t kind);
+    void clearWatchpoints();
+
+    // True if the instruction at emu.pc must not run yet. Once stopped, stays
+    // stopped until resume() is called.
+    bool shouldBreak(const Chip8& emu);
+    void resume();
+
+    bool stopped() const { return reason != StopReason::None; }
+
+    StopReason reason = StopReason::None;
+    uint16_t stopPc{};
+    uint16_t stopAddr{};  // First watched byte touched, for watchpoint stops
+    bool trace = false;   // Print every executed opcode
+
+private:
+    struct Condition {
+        uint16_t addr;
+        uint8_t reg;
+        Compare cmp;
+        uint8_t value;
+    };
+
+    bool hitBreakpoint(const Chip8& emu) const;
+    bool hitWatchpoint(const Chip8& emu);
+
+    std::bitset<MEMORY_SIZE> pcMask;
+    std::bitset<MEMORY_SIZE> unconditional;
+    std::bitset<MEMORY_SIZE> readMask;
+    std::bitset<MEMORY_SIZE> writeMask;
+    std::vector<Condition> conditions;
+    bool watching = false;
+    bool skipOnce = false;
+};
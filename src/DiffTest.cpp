@@ -0,0 +1,232 @@
+#include "DiffTest.h"
+#include <algorithm>
+#include <cstddef>
+#include <unordered_set>
+
+// Instructions between key schedule changes
+static const unsigned int KEY_PERIOD = 64;
+// Every this many key periods, one with all keys released so Fx0A waits
+static const unsigned int RELEASE_PERIODS = 4;
+// Key periods in a row that must start from already seen states before a
+// ROM counts as stuck whatever the keys
+static const unsigned int REPEAT_PERIODS = 8;
+
+
+// Name the state field that holds byte `offset` of Chip8::stateData()
+static std::string describeOffset(size_t offset) {
+    struct Field { const char* name; size_t begin; size_t size; };
+    const size_t base = offsetof(Chip8, registers);
+    const Field fields[] = {
+            {"V",          offsetof(Chip8, registers) - base,  sizeof(Chip8::registers)},
+            {"pc",         offsetof(Chip8, pc) - base,         sizeof(Chip8::pc)},
+            {"index",      offsetof(Chip8, index) - base,      sizeof(Chip8::index)},
+            {"opcode",     offsetof(Chip8, opcode) - base,     sizeof(Chip8::opcode)},
+            {"keypad",     offsetof(Chip8, keypad) - base,     sizeof(Chip8::keypad)},
+            {"sp",         offsetof(Chip8, sp) - base,         sizeof(Chip8::sp)},
+            {"delayTimer", offsetof(Chip8, delayTimer) - base, sizeof(Chip8::delayTimer)},
+            {"soundTimer", offsetof(Chip8, soundTimer) - base, sizeof(Chip8::soundTimer)},
+            {"drawFlag",   offsetof(Chip8, drawFlag) - base,   sizeof(Chip8::drawFlag)},
+            {"stack",      offsetof(Chip8, stack) - base,      sizeof(Chip8::stack)},
+            {"profile",    offsetof(Chip8, profile) - base,    sizeof(Chip8::profile)},
+            {"hires",      offsetof(Chip8, hires) - base,      sizeof(Chip8::hires)},
+            {"reserved",   offsetof(Chip8, reserved) - base,   sizeof(Chip8::reserved)},
+            {"mem",        offsetof(Chip8, mem) - base,        sizeof(Chip8::mem)},
+            {"video",      offsetof(Chip8, video) - base,      sizeof(Chip8::video)},
+            {"flags",      offsetof(Chip8, flags) - base,      sizeof(Chip8::flags)},
+    };
+
+    for (const Field& field : fields) {
+        if (offset >= field.begin && offset < field.begin + field.size) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s+0x%zX", field.name, offset - field.begin);
+            return buf;
+        }
+    }
+    return "offset " + std::to_string(offset);
+}
+
+// Machine state apart from the keypad, which the schedule changes regardless,
+// plus the random engine
+static uint64_t stateHash(const Chip8& emu) {
+    const uint8_t* state = emu.stateData();
+    const size_t keypad = offsetof(Chip8, keypad) - offsetof(Chip8, registers);
+    uint64_t hash = 0x243F6A8885A308D3ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i) hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    };
+    mix(state, keypad);
+    mix(state + keypad + sizeof(emu.keypad), emu.stateSize() - keypad - sizeof(emu.keypad));
+    mix(&emu.randGen, sizeof(emu.randGen));
+    return hash;
+}
+
+static bool compare(const Chip8& a, const Chip8& b, DiffResult* result) {
+    const uint8_t* sa = a.stateData();
+    const uint8_t* sb = b.stateData();
+    if (std::memcmp(sa, sb, a.stateSize()) == 0) return true;
+
+    size_t offset = 0;
+    while (sa[offset] == sb[offset]) ++offset;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s differs (0x%02X vs 0x%02X) after opcode 0x%04X",
+             describeOffset(offset).c_str(), sa[offset], sb[offset], a.opcode);
+    result->mismatch = true;
+    result->detail = buf;
+    return false;
+}
+
+DiffResult lockstep(const std::vector<uint8_t>& rom, const BackendInfo& a, const BackendInfo& b,
+                    const DiffConfig& config) {
+    DiffResult result;
+    Chip8 emuA;
+    Chip8 emuB;
+    for (Chip8* emu : {&emuA, &emuB}) {
+        emu->seed(config.seed);
+        if (!emu->loadRom(rom.data(), rom.size(), config.profile)) {
+            result.rejected = true;
+            result.detail = "ROM too large";
+            return result;
+        }
+    }
+
+    // Keys change every KEY_PERIOD instructions from a schedule derived from the seed
+    std::minstd_rand keyGen(config.seed);
+    const unsigned int block = config.block ? config.block : 1;
+    std::unordered_set<uint64_t> seen;
+    unsigned int repeats = 0;
+
+    uint64_t cycle = 0;
+    while (cycle < config.cycles) {
+        if (cycle % KEY_PERIOD == 0) {
+            // Nothing new to compare once the machine keeps coming back to
+            // the same states under different keys
+            if (seen.insert(stateHash(emuA)).second) repeats = 0;
+            else if (++repeats == REPEAT_PERIODS) {
+                result.repeated = true;
+                break;
+            }
+
+            auto keys = uint16_t(keyGen() & keyGen() & 0xFFFFu);
+            if (cycle / KEY_PERIOD % RELEASE_PERIODS == RELEASE_PERIODS - 1) keys = 0;
+            emuA.keypad = keys;
+            emuB.keypad = keys;
+        }
+
+        // Up to the next comparison, never across a key change
+        auto steps = unsigned(std::min<uint64_t>({block - cycle % block, KEY_PERIOD - cycle % KEY_PERIOD,
+                                                  config.cycles - cycle}));
+        a.run(emuA, steps);
+        b.run(emuB, steps);
+        cycle += steps;
+
+        if (cycle % block == 0 && !compare(emuA, emuB, &result)) break;
+    }
+
+    // Runs that ended between comparisons get a last one
+    result.cycle = cycle;
+    if (!result.mismatch) compare(emuA, emuB, &result);
+    if (!result.mismatch || block == 1) return result;
+
+    // Replay up to here one instruction at a time to find where they part.
+    // Keep the block's result should the replay not reproduce it.
+    DiffConfig narrow = config;
+    narrow.block = 1;
+    narrow.cycles = cycle;
+    DiffResult narrowed = lockstep(rom, a, b, narrow);
+    return narrowed.mismatch ? narrowed : result;
+}
+
+std::vector<uint8_t> shrink(std::vector<uint8_t> rom, const BackendInfo& a, const BackendInfo& b,
+                            DiffConfig config) {
+    if (!lockstep(rom, a, b, config).mismatch) return rom;
+
+    // Candidates keep the whole budget: blanking a taken skip or a call can
+    // move the divergence later without removing it
+    auto stillFails = [&](const std::vector<uint8_t>& candidate) {
+        return lockstep(candidate, a, b, config).mismatch;
+    };
+
+    // Drop the tail, halving the step each time
+    for (size_t step = rom.size() / 2 & ~size_t(1); step >= 2; step = step / 2 & ~size_t(1)) {
+        while (rom.size() > step) {
+            std::vector<uint8_t> candidate(rom.begin(), rom.end() - step);
+            if (!stillFails(candidate)) break;
+            rom = std::move(candidate);
+        }
+    }
+
+    // Blank out instruction ranges, largest first, keeping addresses stable
+    for (size_t chunk = rom.size() / 2 & ~size_t(1); chunk >= 2; chunk = chunk / 2 & ~size_t(1)) {
+        for (size_t begin = 0; begin + chunk <= rom.size(); begin += chunk) {
+            std::vector<uint8_t> candidate = rom;
+            bool changed = false;
+            for (size_t i = begin; i < begin + chunk; ++i) {
+                changed |= candidate[i] != 0;
+                candidate[i] = 0;
+            }
+            if (changed && stillFails(candidate)) rom = std::move(candidate);
+        }
+    }
+
+    // Blanks at the end load the same as the zeroed memory past the ROM
+    while (rom.size() > 2 && !rom[rom.size() - 1] && !rom[rom.size() - 2]) rom.resize(rom.size() - 2);
+    return rom;
+}
+
+// Target for a jump or call at offset `from` of a ROM of `size` bytes. Mostly
+// a short hop forward, so little of the code between here and the loop at
+// the end is skipped. Backward only now and then, and never to the entry
+// point: both close loops that run a handful of instructions forever.
+static uint16_t branchTarget(std::minstd_rand& gen, size_t from, size_t size) {
+    size_t target = from + 4 + 2 * (gen() % 4);
+    if (gen() % 32 == 0 || target + 4 > size) target = size > 2 ? 2 + (gen() % (size - 2) & ~size_t(1)) : 0;
+    return uint16_t(START_ADDRESS + target);
+}
+
+std::vector<uint8_t> randomRom(uint32_t seed, size_t size) {
+    // First nibble, and for the grouped opcodes the selector byte / nibble
+    // SCHIP opcodes are NULL for the other profiles. 00FD is left out, it halts.
+    static const uint8_t SYSTEM[] = {0xE0, 0xE0, 0xE0, 0xEE, 0xC3, 0xFB, 0xFC, 0xFE, 0xFF};
+    static const uint8_t ARITHMETIC[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+    static const uint8_t KEYS[] = {0x9E, 0xA1};
+    static const uint8_t MISC[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65, 0x30, 0x75, 0x85};
+
+    std::minstd_rand gen(seed);
+    std::vector<uint8_t> rom(size & ~size_t(1));
+    for (size_t i=0; i+1<rom.size(); i+=2) {
+        auto opcode = uint16_t(gen());
+        const unsigned int group = opcode >> 12u;
+        // Keep control flow inside the ROM, a jump into zeroed memory only slides to the end
+        if (group == 0x1 || group == 0x2 || group == 0xB) {
+            opcode = (opcode & 0xF000u) | branchTarget(gen, i, rom.size());
+        }
+        // One in eight of the others stays fully random to exercise undefined opcodes
+        else if (gen() % 8 != 0) {
+            switch (group) {
+                case 0x0: opcode = 0x0000u | SYSTEM[gen() % sizeof(SYSTEM)]; break;
+                case 0x8: opcode = (opcode & 0xFFF0u) | ARITHMETIC[gen() % sizeof(ARITHMETIC)]; break;
+                case 0xE: opcode = (opcode & 0xFF00u) | KEYS[gen() % sizeof(KEYS)]; break;
+                case 0xF: opcode = (opcode & 0xFF00u) | MISC[gen() % sizeof(MISC)]; break;
+                default: break;
+            }
+        }
+        rom[i] = opcode >> 8u;
+        rom[i + 1] = opcode & 0xFFu;
+    }
+
+    // Loop back instead of running off the end into zeroed memory. Twice, in
+    // case the instruction before is a skip.
+    for (size_t i = rom.size() >= 4 ? rom.size() - 4 : rom.size(); i + 1 < rom.size(); i += 2) {
+        rom[i] = 0x10u | (START_ADDRESS >> 8u);
+        rom[i + 1] = START_ADDRESS & 0xFFu;
+    }
+    return rom;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Backends.h"
+#include "Chip8.h"
+
+// Lockstep differential testing of execution backends. Two instances load
+// the same ROM with the same seed and key schedule, each backend advances
+// its own instance, and full machine state is compared as they go.
+
+struct DiffConfig {
+    Profile profile = Profile::Modern;
+    uint64_t cycles = 100000;  // Instructions to run before declaring a match
+    unsigned int block = 64;   // Instructions each backend runs between comparisons
+    uint32_t seed = 1;         // Cxkk seed and key schedule
+};
+
+struct DiffResult {
+    bool mismatch = false;
+    bool rejected = false;     // The ROM did not fit in memory, nothing ran
+    bool repeated = false;     // Stopped early: states kept repeating whatever the keys
+    uint64_t cycle{};          // Instructions executed when the run stopped
+    std::string detail;
+};
+
+// A mismatch is narrowed down to the instruction that caused it by running
+// again one instruction at a time, so result.cycle does not depend on block.
+// A run whose state keeps repeating ends before config.cycles.
+DiffResult lockstep(const std::vector<uint8_t>& rom, const BackendInfo& a, const BackendInfo& b,
+                    const DiffConfig& config);
+
+// Reduce a mismatching ROM to a smaller one that still mismatches within
+// config.cycles, by truncating it and replacing instruction ranges with 0x0000
+std::vector<uint8_t> shrink(std::vector<uint8_t> rom, const BackendInfo& a, const BackendInfo& b,
+                            DiffConfig config);
+
+// ROM of `size` bytes of random instructions, biased towards defined opcodes
+std::vector<uint8_t> randomRom(uint32_t seed, size_t size);
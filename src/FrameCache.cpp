@@ -0,0 +1,139 @@
+#include "FrameCache.h"
+#include <cstddef>
+
+// Offsets inside Chip8::stateData()
+static const size_t MEM_BEGIN = offsetof(Chip8, mem) - offsetof(Chip8, registers);
+static const size_t MEM_END = MEM_BEGIN + MEMORY_SIZE;
+
+// Epochs whose mem hash is kept, enough for a few instances each with a few snapshots
+static const size_t MEM_HASHES_MAX = 256;
+
+static_assert(sizeof(std::default_random_engine) % 8 == 0, "random engine is hashed as whole words");
+
+
+static inline uint64_t rotl(uint64_t x, unsigned int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Two independent 64-bit hashes over 8-byte words. size must be a multiple of 8.
+static void hashWords(const void* data, size_t size, uint64_t* a, uint64_t* b) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t ha = *a;
+    uint64_t hb = *b;
+    for (size_t i=0; i<size; i+=8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        ha = rotl((ha ^ word) * 0x9E3779B97F4A7C15ull, 29);
+        hb = rotl(hb + word * 0xC2B2AE3D27D4EB4Full, 31) * 0x165667B19E3779F9ull;
+    }
+    *a = ha;
+    *b = hb;
+}
+
+FrameCache::FrameCache(FrameCacheConfig config) : settings(config) {
+    index.reserve(settings.capacity);
+}
+
+void FrameCache::clear() {
+    order.clear();
+    index.clear();
+    counters = {};
+    memHashes.clear();
+}
+
+FrameCache::Key FrameCache::keyOf(const Chip8& emu) {
+    const uint8_t* state = emu.stateData();
+
+    // mem dominates the state but rarely changes, hash it only when it did
+    auto found = memHashes.find(emu.memEpoch);
+    if (found == memHashes.end()) {
+        if (memHashes.size() >= MEM_HASHES_MAX) memHashes.clear();
+        MemHash mem{{0x243F6A8885A308D3ull, 0x13198A2E03707344ull}};
+        hashWords(state + MEM_BEGIN, MEMORY_SIZE, &mem.hash[0], &mem.hash[1]);
+        found = memHashes.emplace(emu.memEpoch, mem).first;
+    }
+
+    uint64_t a = found->second.hash[0];
+    uint64_t b = found->second.hash[1];
+    hashWords(state, MEM_BEGIN, &a, &b);
+    hashWords(state + MEM_END, emu.stateSize() - MEM_END, &a, &b);
+    hashWords(&emu.randGen, sizeof(emu.randGen), &a, &b);
+    return {a, b};
+}
+
+uint64_t FrameCache::runFrame(Chip8& emu) {
+    Key key = keyOf(emu);
+
+    auto found = index.find(key.primary);
+    if (found != index.end() && found->second->key.check == key.check) {
+        ++counters.hits;
+        if (settings.eviction == Eviction::LRU) order.splice(order.begin(), order, found->second);
+        apply(*found->second, emu);
+        return found->second->instructions;
+    }
+
+    ++counters.misses;
+    record(emu, key);
+    return settings.cyclesPerFrame;
+}
+
+// Execute the frame for real and keep what it changed
+void FrameCache::record(Chip8& emu, const Key& key) {
+    const size_t size = emu.stateSize();
+    before.assign(emu.stateData(), emu.stateData() + size);
+
+    emu.runFrame(settings.cyclesPerFrame);
+
+    if (settings.capacity == 0) return;
+
+    Entry entry{key, {}, {}, emu.randGen, settings.cyclesPerFrame, false};
+    const uint8_t* after = emu.stateData();
+    for (size_t offset=0; offset<size;) {
+        // Most of the state is unchanged, skip it a word at a time
+        if (offset % 8 == 0 && offset + 8 <= size && !std::memcmp(&before[offset], after + offset, 8)) {
+            offset += 8;
+            continue;
+        }
+        if (before[offset] == after[offset]) {
+            ++offset;
+            continue;
+        }
+        size_t end = offset;
+        while (end < size && before[end] != after[end] && end - offset < UINT16_MAX) ++end;
+
+        entry.patches.push_back({uint16_t(offset), uint16_t(end - offset)});
+        entry.data.insert(entry.data.end(), after + offset, after + end);
+        entry.writesMem |= offset < MEM_END && end > MEM_BEGIN;
+        offset = end;
+    }
+
+    // A primary hash collision replaces the older entry
+    auto existing = index.find(key.primary);
+    if (existing != index.end()) {
+        counters.bytes -= existing->second->data.size();
+        order.erase(existing->second);
+        index.erase(existing);
+    }
+    else if (order.size() >= settings.capacity) {
+        counters.bytes -= order.back().data.size();
+        index.erase(order.back().key.primary);
+        order.pop_back();
+        ++counters.evictions;
+    }
+
+    counters.bytes += entry.data.size();
+    order.push_front(std::move(entry));
+    index[key.primary] = order.begin();
+    counters.entries = order.size();
+}
+
+void FrameCache::apply(const Entry& entry, Chip8& emu) {
+    uint8_t* state = emu.stateData();
+    const uint8_t* data = entry.data.data();
+    for (const Patch& patch : entry.patches) {
+        std::memcpy(state + patch.offset, data, patch.length);
+        data += patch.length;
+    }
+    emu.randGen = entry.randGen;
+    if (entry.writesMem) emu.touchMem();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.h"
+
+// Memoizes whole frames. The key is a 128-bit hash of the machine state
+// (which includes the keypad) and the random engine at the start of a frame.
+// A hit replays the recorded state delta instead of executing. Frames advance
+// like Chip8::runFrame(): breakpoints are not checked for replayed frames.
+// A lookup costs about as much as a hundred instructions and a miss far
+// more, so this only pays off for long frames that repeat.
+
+enum class Eviction : uint8_t {
+    LRU,   // Hits refresh an entry
+    FIFO   // Entries leave in insertion order
+};
+
+struct FrameCacheConfig {
+    size_t capacity = 4096;  // Entries
+    Eviction eviction = Eviction::LRU;
+    unsigned int cyclesPerFrame = CYCLES_PER_FRAME;
+};
+
+struct FrameCacheStats {
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};
+    size_t entries{};
+    size_t bytes{};  // Delta payload held
+
+    double hitRate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+};
+
+class FrameCache {
+public:
+    explicit FrameCache(FrameCacheConfig config = {});
+
+    // Advance emu by one frame, from the cache when possible. Returns the
+    // number of instructions the frame executed.
+    uint64_t runFrame(Chip8& emu);
+
+    void clear();
+    const FrameCacheStats& stats() const { return counters; }
+    const FrameCacheConfig& config() const { return settings; }
+
+private:
+    struct Key {
+        uint64_t primary;
+        uint64_t check;
+    };
+
+    // Bytes [offset, offset + length) of Chip8::stateData() become data
+    struct Patch {
+        uint16_t offset;
+        uint16_t length;
+    };
+
+    struct Entry {
+        Key key;
+        std::vector<Patch> patches;
+        std::vector<uint8_t> data;
+        std::default_random_engine randGen;
+        uint64_t instructions;
+        bool writesMem;
+    };
+
+    Key keyOf(const Chip8& emu);
+    void record(Chip8& emu, const Key& key);
+    void apply(const Entry& entry, Chip8& emu);
+
+    FrameCacheConfig settings;
+    FrameCacheStats counters;
+    std::list<Entry> order;  // Front is evicted last
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    std::vector<uint8_t> before;
+
+    // mem hashes by Chip8::memEpoch, which identifies mem contents. Cleared
+    // when full; instances only ever look up their current epoch.
+    struct MemHash {
+        uint64_t hash[2];
+    };
+    std::unordered_map<uint64_t, MemHash> memHashes;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "Batch.h"
+#include "Chip8.h"
+
+// Wire format shared by chip8_ipc_server and its clients. Commands travel as
+// fixed-size records over a SOCK_SEQPACKET Unix socket; observations are
+// published into a shared-memory ring that clients map read-only.
+
+const uint32_t IPC_MAGIC = 0x43384950;  // "C8IP"
+const uint32_t IPC_VERSION = 2;
+const unsigned int IPC_PATH_MAX = 256;
+const unsigned int IPC_DEFAULT_RING_SLOTS = 8;
+
+enum IpcCommand : uint32_t {
+    IPC_LOAD_ROM,   // path, arg = Profile
+    IPC_RESET,      // reload the last ROM
+    IPC_STEP,       // arg = frames to run
+    IPC_SET_KEYS,   // arg = keypad mask, bit i is key i
+    IPC_SET_REWARD  // arg = register whose increase is reported as reward
+};
+
+enum IpcStatus : int32_t {
+    IPC_OK = 0,
+    IPC_BAD_INSTANCE = -1,
+    IPC_BAD_COMMAND = -2,
+    IPC_ROM_ERROR = -3
+};
+
+struct IpcRequest {
+    uint32_t command;
+    uint32_t instance;
+    uint32_t arg;
+    char path[IPC_PATH_MAX];
+};
+
+struct IpcReply {
+    int32_t status;
+    uint32_t slot;  // Ring slot holding the newest observation
+    uint64_t seq;   // Its sequence number
+};
+
+// One published frame. seq is cleared before the payload is written and set
+// last with release order, so a reader that loads it with acquire order
+// before and after copying the payload can detect torn slots.
+struct IpcObservation {
+    std::atomic<uint64_t> seq;
+    uint64_t cycles;  // Instructions executed since the last reset
+    int32_t reward;
+    BatchState state;
+    uint8_t video[VIDEO_HEIGHT][VIDEO_WIDTH / 8];  // ObsFormat::Packed1
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seq is shared across processes");
+
+struct IpcShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t instances;
+    uint32_t ringSlots;
+};
+
+// Slots follow the header, instance-major: ring of instance i starts at i * ringSlots
+inline size_t ipcShmSize(uint32_t instances, uint32_t ringSlots) {
+    return sizeof(IpcShmHeader) + size_t(instances) * ringSlots * sizeof(IpcObservation);
+}
+
+inline IpcObservation* ipcSlot(IpcShmHeader* header, uint32_t instance, uint32_t slot) {
+    auto* slots = reinterpret_cast<IpcObservation*>(header + 1);
+    return &slots[size_t(instance) * header->ringSlots + slot];
+}
+
+inline const IpcObservation* ipcSlot(const IpcShmHeader* header, uint32_t instance, uint32_t slot) {
+    auto* slots = reinterpret_cast<const IpcObservation*>(header + 1);
+    return &slots[size_t(instance) * header->ringSlots + slot];
+}
@@ -0,0 +1,169 @@
+#include "IpcServer.h"
+#include "Batch.h"
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+IpcServer::IpcServer(std::string socketPath, std::string shmName, uint32_t instances, uint32_t ringSlots)
+    : socketPath(std::move(socketPath)), shmName(std::move(shmName)), ringSlots(ringSlots), instances(instances)
+{
+}
+
+IpcServer::~IpcServer() {
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    if (shm) {
+        munmap(shm, shmSize);
+        shm_unlink(shmName.c_str());
+    }
+}
+
+bool IpcServer::open() {
+    shmSize = ipcShmSize(instances.size(), ringSlots);
+    int shmFd = shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0600);
+    if (shmFd < 0 || ftruncate(shmFd, shmSize) != 0) {
+        perror("shm_open");
+        if (shmFd >= 0) close(shmFd);
+        return false;
+    }
+    void* addr = mmap(nullptr, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+    close(shmFd);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+    shm = static_cast<IpcShmHeader*>(addr);
+    std::memset(shm, 0, shmSize);
+    shm->instances = instances.size();
+    shm->ringSlots = ringSlots;
+    shm->version = IPC_VERSION;
+    shm->magic = IPC_MAGIC;
+
+    sockaddr_un sockAddr{};
+    if (socketPath.size() >= sizeof(sockAddr.sun_path)) {
+        std::cout << "Socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+    sockAddr.sun_family = AF_UNIX;
+    std::strcpy(sockAddr.sun_path, socketPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&sockAddr, sizeof(sockAddr)) != 0 || listen(listenFd, 4) != 0) {
+        perror("socket");
+        return false;
+    }
+    return true;
+}
+
+void IpcServer::serve() {
+    running = true;
+    while (running) {
+        int client = accept(listenFd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            return;
+        }
+
+        IpcRequest request{};
+        while (running) {
+            ssize_t n = recv(client, &request, sizeof(request), 0);
+            if (n <= 0) break;
+
+            IpcReply reply{};
+            if (size_t(n) != sizeof(request)) reply.status = IPC_BAD_COMMAND;
+            else reply = handle(request);
+
+            if (send(client, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)) break;
+        }
+        close(client);
+    }
+}
+
+IpcReply IpcServer::handle(const IpcRequest& request) {
+    IpcReply reply{};
+    if (request.instance >= instances.size()) {
+        reply.status = IPC_BAD_INSTANCE;
+        return reply;
+    }
+    Instance& inst = instances[request.instance];
+
+    switch (request.command) {
+        case IPC_LOAD_ROM: {
+            Profile profile = request.arg <= uint32_t(Profile::SuperChip) ? Profile(request.arg) : Profile::Modern;
+            inst.rom = RomStore::process().open(std::string(request.path, strnlen(request.path, IPC_PATH_MAX)));
+            inst.emu.reset();
+            if (!inst.rom || !inst.emu.loadRom(inst.rom->data, inst.rom->size, profile)) reply.status = IPC_ROM_ERROR;
+            inst.cycles = 0;
+            break;
+        }
+
+        case IPC_RESET:
+            inst.emu.reset();
+            if (!inst.rom || !inst.emu.loadRom(inst.rom->data, inst.rom->size, inst.emu.profile)) {
+                reply.status = IPC_ROM_ERROR;
+            }
+            inst.cycles = 0;
+            break;
+
+        case IPC_STEP: {
+            uint8_t before = inst.rewardRegister < 16 ? inst.emu.registers[inst.rewardRegister] : 0;
+            for (uint32_t frame=0; frame<request.arg; ++frame) {
+                if (frameCache) inst.cycles += frameCache->runFrame(inst.emu);
+                else {
+                    inst.emu.runFrame();
+                    inst.cycles += CYCLES_PER_FRAME;
+                }
+            }
+
+            int32_t reward = 0;
+            if (inst.rewardRegister < 16) reward = int32_t(inst.emu.registers[inst.rewardRegister]) - before;
+            publish(inst, request.instance, reward, &reply);
+            return reply;
+        }
+
+        case IPC_SET_KEYS:
+            inst.emu.keypad = request.arg & 0xFFFFu;
+            break;
+
+        case IPC_SET_REWARD:
+            inst.rewardRegister = request.arg < 16 ? request.arg : 0xFF;
+            break;
+
+        default:
+            reply.status = IPC_BAD_COMMAND;
+            break;
+    }
+
+    reply.seq = inst.seq;
+    reply.slot = inst.seq % ringSlots;
+    return reply;
+}
+
+void IpcServer::publish(Instance& inst, uint32_t id, int32_t reward, IpcReply* reply) {
+    uint64_t seq = ++inst.seq;
+    uint32_t slot = seq % ringSlots;
+    IpcObservation* obs = ipcSlot(shm, id, slot);
+    const Chip8& emu = inst.emu;
+
+    obs->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    obs->cycles = inst.cycles;
+    obs->reward = reward;
+    exportState(emu, &obs->state);
+    exportObservation(emu, ObsFormat::Packed1, &obs->video[0][0]);
+
+    obs->seq.store(seq, std::memory_order_release);
+
+    reply->seq = seq;
+    reply->slot = slot;
+}
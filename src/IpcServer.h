@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Chip8.h"
+#include "FrameCache.h"
+#include "IpcProtocol.h"
+#include "RomStore.h"
+
+// Hosts a set of headless Chip8 instances for an external driver. Commands
+// arrive on a Unix socket, every IPC_STEP publishes the resulting frame into
+// the shared-memory ring of that instance.
+class IpcServer {
+public:
+    IpcServer(std::string socketPath, std::string shmName, uint32_t instances,
+              uint32_t ringSlots = IPC_DEFAULT_RING_SLOTS);
+    ~IpcServer();
+
+    // Create the socket and the shared-memory ring
+    bool open();
+    // Serve clients one at a time until stop() or a socket error
+    void serve();
+    void stop() { running = false; }
+
+    // Run frames through a memoization cache shared by all instances
+    void setFrameCache(FrameCache* cache) { frameCache = cache; }
+
+    IpcReply handle(const IpcRequest& request);
+
+private:
+    struct Instance {
+        Chip8 emu;
+        std::shared_ptr<const RomImage> rom;  // Shared with every instance running it
+        uint8_t rewardRegister = 0xFF;  // 0xFF: no reward
+        uint64_t seq{};
+        uint64_t cycles{};
+    };
+
+    void publish(Instance& inst, uint32_t id, int32_t reward, IpcReply* reply);
+
+    std::string socketPath;
+    std::string shmName;
+    uint32_t ringSlots;
+    std::vector<Instance> instances;
+    FrameCache* frameCache{};
+
+    int listenFd = -1;
+    IpcShmHeader* shm{};
+    size_t shmSize{};
+    volatile bool running = false;
+};
@@ -0,0 +1,217 @@
+#include "PerfCounters.h"
+#include <algorithm>
+#include <cerrno>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    for (unsigned int i=0; i<PERF_EVENT_COUNT; ++i) value[i] += other.value[i];
+    return *this;
+}
+
+PerfSample PerfSample::operator-(const PerfSample& other) const {
+    PerfSample result;
+    for (unsigned int i=0; i<PERF_EVENT_COUNT; ++i) result.value[i] = value[i] - other.value[i];
+    return result;
+}
+
+#ifdef __linux__
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool PerfCounters::open() {
+    const struct { uint32_t type; uint64_t config; } events[PERF_EVENT_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+
+    for (unsigned int i=0; i<PERF_EVENT_COUNT; ++i) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = leader < 0;  // The group starts with its leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (fd < 0) {
+            if (lastError.empty()) lastError = std::string("perf_event_open: ") + std::strerror(errno);
+            continue;
+        }
+        fds[i] = fd;
+        available[i] = true;
+        groupOrder[groupSize++] = i;
+        if (leader < 0) leader = fd;
+    }
+
+    if (leader < 0) return false;
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+// One read of the leader returns the whole group: {nr, values in open order}
+PerfSample PerfCounters::read() const {
+    PerfSample sample;
+    uint64_t buffer[1 + PERF_EVENT_COUNT]{};
+    if (leader < 0 || ::read(leader, buffer, sizeof(buffer)) < ssize_t(sizeof(uint64_t))) return sample;
+
+    for (unsigned int i=0; i<buffer[0] && i<groupSize; ++i) sample.value[groupOrder[i]] = buffer[1 + i];
+    return sample;
+}
+
+#else
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::open() {
+    lastError = "perf_event_open is Linux only";
+    return false;
+}
+
+PerfSample PerfCounters::read() const {
+    return {};
+}
+
+#endif
+
+// Typical cost of a back-to-back pair of reads, subtracted from
+// per-instruction samples
+static PerfSample readOverhead(const PerfCounters& counters) {
+    const unsigned int samples = 1001;
+    std::vector<PerfSample> deltas(samples);
+    for (PerfSample& delta : deltas) {
+        PerfSample before = counters.read();
+        delta = counters.read() - before;
+    }
+
+    PerfSample median;
+    for (unsigned int event=0; event<PERF_EVENT_COUNT; ++event) {
+        std::nth_element(deltas.begin(), deltas.begin() + samples / 2, deltas.end(),
+                         [event](const PerfSample& a, const PerfSample& b) { return a.value[event] < b.value[event]; });
+        median.value[event] = deltas[samples / 2].value[event];
+    }
+    return median;
+}
+
+// Remove the cost of the read that closed a sample, clamping at zero
+static PerfSample withoutOverhead(PerfSample delta, const PerfSample& overhead) {
+    for (unsigned int event=0; event<PERF_EVENT_COUNT; ++event) {
+        uint64_t cost = delta.value[event];
+        delta.value[event] = cost > overhead.value[event] ? cost - overhead.value[event] : 0;
+    }
+    return delta;
+}
+
+PerfReport profileFrames(Chip8& emu, const BackendInfo& backend, unsigned int frames,
+                         PerfCounters& counters, bool perInstruction) {
+    PerfReport report;
+    report.perInstruction = perInstruction;
+    report.perFrame.reserve(frames);
+
+    PerfSample overhead;
+    if (counters.isOpen()) overhead = readOverhead(counters);
+
+    auto start = std::chrono::steady_clock::now();
+    PerfSample previous = counters.read();
+    for (unsigned int frame=0; frame<frames; ++frame) {
+        PerfSample frameCost;
+
+        if (perInstruction) {
+            // The frame costs what its instructions cost, not the reads in between
+            for (unsigned int cycle=0; cycle<CYCLES_PER_FRAME; ++cycle) {
+                FamilyStats& family = report.families[emu.mem[emu.pc & (MEMORY_SIZE - 1)] >> 4u];
+                PerfSample before = counters.read();
+                backend.untimed(emu, 1);
+                PerfSample cost = withoutOverhead(counters.read() - before, overhead);
+
+                family.counters += cost;
+                ++family.dispatches;
+                frameCost += cost;
+            }
+            // The frame's timer tick belongs to no family
+            PerfSample before = counters.read();
+            emu.tickTimers();
+            frameCost += withoutOverhead(counters.read() - before, overhead);
+        }
+        else {
+            // Frames are chained: each read closes one frame and opens the next
+            backend.untimed(emu, CYCLES_PER_FRAME);
+            emu.tickTimers();
+            PerfSample now = counters.read();
+            frameCost = withoutOverhead(now - previous, overhead);
+            previous = now;
+        }
+
+        report.perFrame.push_back(frameCost);
+        report.total += frameCost;
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.frames = frames;
+    report.guestInstructions = uint64_t(frames) * CYCLES_PER_FRAME;
+    return report;
+}
+
+static double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? double(numerator) / double(denominator) : 0.0;
+}
+
+void printReport(const PerfReport& report, const PerfCounters& counters) {
+    const uint64_t guest = report.guestInstructions;
+    printf("%llu frames, %llu guest instructions in %.3f s: %.2f M guest instructions/s%s\n",
+           (unsigned long long)report.frames, (unsigned long long)guest, report.seconds,
+           ratio(guest, 1) / report.seconds / 1e6, report.perInstruction ? " (per-instruction reads)" : "");
+
+    if (!counters.isOpen()) {
+        printf("Hardware counters unavailable: %s\n", counters.error().c_str());
+        return;
+    }
+
+    const char* names[PERF_EVENT_COUNT] = {"cycles", "instructions", "branch-misses", "L1D-misses"};
+    for (unsigned int event=0; event<PERF_EVENT_COUNT; ++event) {
+        if (!counters.available[event]) printf("%s: not supported on this host\n", names[event]);
+    }
+
+    const PerfSample& t = report.total;
+    printf("host cycles / guest instruction       %8.2f\n", ratio(t.value[PERF_CYCLES], guest));
+    printf("host instructions / guest instruction %8.2f\n", ratio(t.value[PERF_INSTRUCTIONS], guest));
+    printf("host IPC                              %8.2f\n", ratio(t.value[PERF_INSTRUCTIONS], t.value[PERF_CYCLES]));
+    printf("branch misses / dispatch              %8.4f\n", ratio(t.value[PERF_BRANCH_MISSES], guest));
+    printf("L1D misses / 1k guest instructions    %8.2f\n", 1000 * ratio(t.value[PERF_L1D_MISSES], guest));
+
+    if (!report.perFrame.empty()) {
+        std::vector<uint64_t> cycles;
+        cycles.reserve(report.perFrame.size());
+        for (const PerfSample& frame : report.perFrame) cycles.push_back(frame.value[PERF_CYCLES]);
+        std::sort(cycles.begin(), cycles.end());
+        printf("host cycles / frame: p50 %llu, p99 %llu, max %llu\n",
+               (unsigned long long)cycles[cycles.size() / 2],
+               (unsigned long long)cycles[cycles.size() * 99 / 100], (unsigned long long)cycles.back());
+    }
+
+    if (!report.perInstruction) return;
+    printf("\nfamily  dispatches  cycles/op  instr/op  br-miss/op  L1D-miss/op\n");
+    for (unsigned int family=0; family<16; ++family) {
+        const FamilyStats& f = report.families[family];
+        if (!f.dispatches) continue;
+        printf("%Xxxx   %10llu  %9.1f  %8.1f  %10.4f  %11.4f\n", family, (unsigned long long)f.dispatches,
+               ratio(f.counters.value[PERF_CYCLES], f.dispatches),
+               ratio(f.counters.value[PERF_INSTRUCTIONS], f.dispatches),
+               ratio(f.counters.value[PERF_BRANCH_MISSES], f.dispatches),
+               ratio(f.counters.value[PERF_L1D_MISSES], f.dispatches));
+    }
+}
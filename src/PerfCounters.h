@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Backends.h"
+#include "Chip8.h"
+
+// Host hardware counters read through Linux perf_event_open, attributed to
+// guest frames and opcode families. Counters the host does not expose read
+// as zero and are flagged in PerfCounters::available.
+
+enum PerfEvent : unsigned int {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_EVENT_COUNT
+};
+
+struct PerfSample {
+    uint64_t value[PERF_EVENT_COUNT]{};
+
+    PerfSample& operator+=(const PerfSample& other);
+    PerfSample operator-(const PerfSample& other) const;
+};
+
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Open the counters for this thread, user space only. False if none of
+    // them could be opened; error() says why.
+    bool open();
+    bool isOpen() const { return leader >= 0; }
+    const std::string& error() const { return lastError; }
+
+    // Running totals since open()
+    PerfSample read() const;
+
+    bool available[PERF_EVENT_COUNT]{};
+
+private:
+    int leader = -1;
+    int fds[PERF_EVENT_COUNT]{-1, -1, -1, -1};
+    // Group member i reports event groupOrder[i]
+    unsigned int groupOrder[PERF_EVENT_COUNT]{};
+    unsigned int groupSize{};
+    std::string lastError;
+};
+
+struct FamilyStats {
+    uint64_t dispatches{};
+    PerfSample counters;
+};
+
+struct PerfReport {
+    uint64_t frames{};
+    uint64_t guestInstructions{};
+    double seconds{};
+    PerfSample total;
+    std::vector<PerfSample> perFrame;
+    // Indexed by the first opcode nibble, only filled by per-instruction runs
+    FamilyStats families[16];
+    bool perInstruction = false;
+};
+
+// Run `frames` frames of emu through backend, reading counters between
+// frames. A frame is what Chip8::runFrame() runs: CYCLES_PER_FRAME
+// instructions, then one timer tick. With perInstruction, counters are instead read around every single
+// instruction and charged to its opcode family. The measured cost of a read
+// is subtracted from every sample. Per-instruction mode is far slower, and
+// its wall-clock rate is not a throughput number.
+PerfReport profileFrames(Chip8& emu, const BackendInfo& backend, unsigned int frames,
+                         PerfCounters& counters, bool perInstruction);
+
+// Emulated instructions per second next to host cycles per guest
+// instruction, branch misses per dispatch and friends
+void printReport(const PerfReport& report, const PerfCounters& counters);
@@ -0,0 +1,404 @@
+#include "RomStore.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<BasicBlock>::value, "blocks are persisted as a raw array");
+
+// Layout of <cacheDir>/<hash>.analysis: this header, blocks[blockCount],
+// then listingSize bytes of text
+struct AnalysisHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t romHash;
+    uint32_t romSize;
+    uint32_t blockCount;
+    uint32_t listingSize;
+    uint32_t reserved;
+};
+
+static const char ANALYSIS_MAGIC[4] = {'C', '8', 'R', 'A'};
+// Bump whenever BasicBlock or the analysis itself change
+static const uint32_t ANALYSIS_VERSION = 3;
+
+// Instruction fields, split once while analysing
+struct DecodedOp {
+    uint16_t opcode;
+    uint16_t nnn;
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t kk;
+};
+
+
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i=0; i<size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+
+RomStore::RomStore(std::string cacheDir) : cacheDir(std::move(cacheDir)) {
+}
+
+RomStore& RomStore::process() {
+    static RomStore store;
+    return store;
+}
+
+std::string RomStore::defaultCacheDir() {
+    if (const char* dir = std::getenv("CHIP8_CACHE_DIR")) return dir;
+    if (const char* dir = std::getenv("XDG_CACHE_HOME")) return std::string(dir) + "/chip8";
+    if (const char* dir = std::getenv("HOME")) return std::string(dir) + "/.cache/chip8";
+    return "";
+}
+
+std::shared_ptr<const RomImage> RomStore::open(const std::string& path) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        lastError = path + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        lastError = path + ": not a regular file";
+        close(fd);
+        return nullptr;
+    }
+    if (info.st_size == 0 || size_t(info.st_size) > ROM_MAX_SIZE) {
+        lastError = path + ": " + std::to_string(info.st_size) + " bytes, a ROM holds 1 to " +
+                    std::to_string(ROM_MAX_SIZE);
+        close(fd);
+        return nullptr;
+    }
+
+    // Same file, unchanged since it was read
+    FileId id{uint64_t(info.st_dev), uint64_t(info.st_ino), int64_t(info.st_size),
+              int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec};
+    auto known = byFile.find(id);
+    if (known != byFile.end()) {
+        if (auto image = known->second.lock()) {
+            close(fd);
+            return image;
+        }
+    }
+
+    // The file may change while it is read; whatever was read is the image
+    std::vector<uint8_t> contents(size_t(info.st_size));
+    size_t filled = 0;
+    int readError = 0;
+    while (filled < contents.size()) {
+        ssize_t count = read(fd, contents.data() + filled, contents.size() - filled);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) readError = errno;
+        if (count <= 0) break;
+        filled += size_t(count);
+    }
+    close(fd);
+    if (readError || filled == 0) {
+        lastError = path + ": " + (readError ? std::strerror(readError) : "truncated while reading");
+        return nullptr;
+    }
+    contents.resize(filled);
+    uint64_t hash = fnv1a(contents.data(), contents.size());
+    auto image = std::make_shared<const RomImage>(std::move(contents), hash);
+
+    // Same bytes under another name: keep the image already shared
+    auto twin = byHash.find(image->hash);
+    if (twin != byHash.end()) {
+        auto existing = twin->second.lock();
+        if (existing && existing->size == image->size && !std::memcmp(existing->data, image->data, image->size)) {
+            image = existing;
+        }
+    }
+
+    // Drop what no caller holds any more, and older versions of this file,
+    // so a long run over edited or short-lived ROMs does not grow the maps
+    for (auto entry = byFile.begin(); entry != byFile.end();) {
+        bool sameFile = entry->first.device == id.device && entry->first.inode == id.inode;
+        if (sameFile || entry->second.expired()) entry = byFile.erase(entry);
+        else ++entry;
+    }
+    for (auto entry = byHash.begin(); entry != byHash.end();) {
+        if (entry->second.expired()) entry = byHash.erase(entry);
+        else ++entry;
+    }
+    byFile[id] = image;
+    byHash[image->hash] = image;
+    return image;
+}
+
+std::shared_ptr<const RomAnalysis> RomStore::analyze(const RomImage& rom) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto known = analyses.find(rom.hash);
+    if (known != analyses.end()) return known->second;
+
+    std::shared_ptr<RomAnalysis> analysis = loadAnalysis(rom);
+    if (!analysis) {
+        analysis = std::make_shared<RomAnalysis>(analyzeRom(rom.data, rom.size));
+        saveAnalysis(rom, *analysis);
+    }
+    analyses[rom.hash] = analysis;
+    return analysis;
+}
+
+std::string RomStore::analysisPath(uint64_t hash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.analysis", (unsigned long long)hash);
+    return cacheDir + name;
+}
+
+std::shared_ptr<RomAnalysis> RomStore::loadAnalysis(const RomImage& rom) const {
+    if (cacheDir.empty()) return nullptr;
+
+    std::ifstream file(analysisPath(rom.hash), std::ios::binary);
+    AnalysisHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return nullptr;
+    if (std::memcmp(header.magic, ANALYSIS_MAGIC, sizeof(ANALYSIS_MAGIC)) || header.version != ANALYSIS_VERSION ||
+        header.romHash != rom.hash || header.romSize != rom.size || header.blockCount > rom.size ||
+        header.listingSize > (1u << 20)) {
+        return nullptr;
+    }
+
+    auto analysis = std::make_shared<RomAnalysis>();
+    analysis->blocks.resize(header.blockCount);
+    analysis->listing.resize(header.listingSize);
+    file.read(reinterpret_cast<char*>(analysis->blocks.data()), header.blockCount * sizeof(BasicBlock));
+    file.read(&analysis->listing[0], header.listingSize);
+    if (!file) return nullptr;
+
+    analysis->fromCache = true;
+    return analysis;
+}
+
+// Best effort: a cache that can not be written only costs the next start
+void RomStore::saveAnalysis(const RomImage& rom, const RomAnalysis& analysis) const {
+    if (cacheDir.empty()) return;
+
+    for (size_t slash = cacheDir.find('/', 1); ; slash = cacheDir.find('/', slash + 1)) {
+        mkdir(cacheDir.substr(0, slash).c_str(), 0755);
+        if (slash == std::string::npos) break;
+    }
+
+    AnalysisHeader header{};
+    std::memcpy(header.magic, ANALYSIS_MAGIC, sizeof(ANALYSIS_MAGIC));
+    header.version = ANALYSIS_VERSION;
+    header.romHash = rom.hash;
+    header.romSize = uint32_t(rom.size);
+    header.blockCount = uint32_t(analysis.blocks.size());
+    header.listingSize = uint32_t(analysis.listing.size());
+
+    // Readers never see a partial file: write aside, then rename over
+    std::string path = analysisPath(rom.hash);
+    std::string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(analysis.blocks.data()), analysis.blocks.size() * sizeof(BasicBlock));
+        file.write(analysis.listing.data(), analysis.listing.size());
+        if (!file) {
+            file.close();
+            unlink(temporary.c_str());
+            return;
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) < 0) unlink(temporary.c_str());
+}
+
+
+std::string disassemble(uint16_t opcode) {
+    const unsigned int x = (opcode >> 8u) & 0xFu;
+    const unsigned int y = (opcode >> 4u) & 0xFu;
+    const unsigned int n = opcode & 0xFu;
+    const unsigned int kk = opcode & 0xFFu;
+    const unsigned int nnn = opcode & 0xFFFu;
+
+    char text[32];
+    switch (opcode & 0xF000u) {
+        case 0x0000:
+            if (opcode == 0x00E0) return "CLS";
+            if (opcode == 0x00EE) return "RET";
+            if (opcode == 0x00FB) return "SCR";
+            if (opcode == 0x00FC) return "SCL";
+            if (opcode == 0x00FD) return "EXIT";
+            if (opcode == 0x00FE) return "LOW";
+            if (opcode == 0x00FF) return "HIGH";
+            if ((opcode & 0xFFF0u) == 0x00C0u) {
+                std::snprintf(text, sizeof(text), "SCD %u", n);
+                break;
+            }
+            std::snprintf(text, sizeof(text), "SYS 0x%03X", nnn);
+            break;
+        case 0x1000: std::snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+        case 0x2000: std::snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+        case 0x3000: std::snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+        case 0x4000: std::snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+        case 0x5000: std::snprintf(text, sizeof(text), "SE V%X, V%X", x, y); break;
+        case 0x6000: std::snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+        case 0x7000: std::snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+        case 0x8000: {
+            static const char* const names[16] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                                                  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+            if (!names[n]) std::snprintf(text, sizeof(text), "DW 0x%04X", opcode);
+            else std::snprintf(text, sizeof(text), "%s V%X, V%X", names[n], x, y);
+            break;
+        }
+        case 0x9000: std::snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case 0xA000: std::snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+        case 0xB000: std::snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn); break;
+        case 0xC000: std::snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+        case 0xD000: std::snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+        case 0xE000:
+            if (kk == 0x9E) std::snprintf(text, sizeof(text), "SKP V%X", x);
+            else if (kk == 0xA1) std::snprintf(text, sizeof(text), "SKNP V%X", x);
+            else std::snprintf(text, sizeof(text), "DW 0x%04X", opcode);
+            break;
+        default:
+            switch (kk) {
+                case 0x07: std::snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+                case 0x0A: std::snprintf(text, sizeof(text), "LD V%X, K", x); break;
+                case 0x15: std::snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+                case 0x18: std::snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+                case 0x1E: std::snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+                case 0x29: std::snprintf(text, sizeof(text), "LD F, V%X", x); break;
+                case 0x33: std::snprintf(text, sizeof(text), "LD B, V%X", x); break;
+                case 0x55: std::snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+                case 0x65: std::snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+                case 0x30: std::snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+                case 0x75: std::snprintf(text, sizeof(text), "LD R, V%X", x); break;
+                case 0x85: std::snprintf(text, sizeof(text), "LD V%X, R", x); break;
+                default: std::snprintf(text, sizeof(text), "DW 0x%04X", opcode); break;
+            }
+            break;
+    }
+    return text;
+}
+
+// Where control goes after the instruction at address. Plain instructions
+// have the single successor address + 2.
+static unsigned int successorsOf(const DecodedOp& op, uint16_t address, uint16_t* next, bool* indirect) {
+    *indirect = false;
+    switch (op.opcode >> 12u) {
+        case 0x0:
+            if (op.opcode == 0x00FD) return 0;  // SCHIP exit
+            if (op.opcode != 0x00EE) break;
+            *indirect = true;
+            return 0;
+        case 0x1:
+            next[0] = op.nnn;
+            return 1;
+        case 0x2:
+            next[0] = op.nnn;
+            next[1] = address + 2;
+            return 2;
+        case 0x3: case 0x4: case 0x5: case 0x9:
+            next[0] = address + 2;
+            next[1] = address + 4;
+            return 2;
+        case 0xB:
+            *indirect = true;
+            return 0;
+        case 0xE:
+            if (op.kk != 0x9E && op.kk != 0xA1) break;
+            next[0] = address + 2;
+            next[1] = address + 4;
+            return 2;
+        default:
+            break;
+    }
+    next[0] = address + 2;
+    return 1;
+}
+
+RomAnalysis analyzeRom(const uint8_t* data, size_t size) {
+    RomAnalysis analysis;
+    // Indexed by address - START_ADDRESS. Every byte address gets an entry,
+    // jumps to odd addresses are legal.
+    std::vector<DecodedOp> decoded(size);
+    auto at = [&decoded](uint16_t address) -> const DecodedOp& { return decoded[address - START_ADDRESS]; };
+    for (size_t i=0; i<size; ++i) {
+        uint16_t opcode = uint16_t(data[i] << 8u) | (i + 1 < size ? data[i + 1] : 0);
+        decoded[i] = {opcode, uint16_t(opcode & 0x0FFFu), uint8_t((opcode >> 8u) & 0xFu),
+                               uint8_t((opcode >> 4u) & 0xFu), uint8_t(opcode & 0xFu), uint8_t(opcode & 0xFFu)};
+    }
+
+    // Only whole instructions inside the ROM are followed
+    const unsigned int end = START_ADDRESS + size;
+    auto inRom = [end](unsigned int address) { return address >= START_ADDRESS && address + 2 <= end; };
+
+    std::vector<bool> reached(size), leader(size);
+    std::vector<uint16_t> pending;
+    if (inRom(START_ADDRESS)) {
+        leader[0] = true;
+        pending.push_back(START_ADDRESS);
+    }
+    while (!pending.empty()) {
+        uint16_t address = pending.back();
+        pending.pop_back();
+        if (!inRom(address) || reached[address - START_ADDRESS]) continue;
+        reached[address - START_ADDRESS] = true;
+
+        uint16_t next[2];
+        bool indirect;
+        unsigned int count = successorsOf(at(address), address, next, &indirect);
+        bool branches = indirect || count != 1 || next[0] != address + 2;
+        for (unsigned int i=0; i<count; ++i) {
+            if (branches && inRom(next[i])) leader[next[i] - START_ADDRESS] = true;
+            pending.push_back(next[i]);
+        }
+    }
+
+    for (unsigned int begin=START_ADDRESS; begin<end; ++begin) {
+        if (!reached[begin - START_ADDRESS] || !leader[begin - START_ADDRESS]) continue;
+
+        BasicBlock block{};
+        block.begin = uint16_t(begin);
+        for (uint16_t address = uint16_t(begin); ; address += 2) {
+            uint16_t next[2];
+            bool indirect;
+            unsigned int count = successorsOf(at(address), address, next, &indirect);
+            uint16_t following = address + 2;
+            if (indirect || count != 1 || next[0] != following || !inRom(following) ||
+                leader[following - START_ADDRESS]) {
+                block.end = following;
+                block.successorCount = uint8_t(count);
+                block.successors[0] = count > 0 ? next[0] : 0;
+                block.successors[1] = count > 1 ? next[1] : 0;
+                block.indirect = indirect;
+                break;
+            }
+        }
+        analysis.blocks.push_back(block);
+    }
+
+    char line[64];
+    for (unsigned int address=START_ADDRESS; address<end;) {
+        const unsigned int offset = address - START_ADDRESS;
+        if (leader[offset] && reached[offset]) {
+            std::snprintf(line, sizeof(line), "L%03X:\n", address);
+            analysis.listing += line;
+        }
+        if (reached[offset]) {
+            const DecodedOp& op = decoded[offset];
+            std::snprintf(line, sizeof(line), "  %03X  %04X  ", address, op.opcode);
+            analysis.listing += line + disassemble(op.opcode) + "\n";
+            address += 2;
+        }
+        else {
+            std::snprintf(line, sizeof(line), "  %03X  %02X    DB 0x%02X\n", address, data[offset], data[offset]);
+            analysis.listing += line;
+            ++address;
+        }
+    }
+    return analysis;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.h"
+
+// Immutable ROM images, read once and identified by the 64-bit FNV-1a hash
+// of their contents. A file opened again, or another file with the same
+// bytes, shares the image already read, so every instance in a process
+// loads from one copy. Per-ROM analysis is persisted next to other ROMs'
+// under the cache directory and keyed by the same hash.
+
+const size_t ROM_MAX_SIZE = MEMORY_SIZE - START_ADDRESS;
+
+struct RomImage {
+    RomImage(std::vector<uint8_t> contents, uint64_t hash)
+        : bytes(std::move(contents)), data(bytes.data()), size(bytes.size()), hash(hash) {}
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    // A private copy: later changes to the file do not reach it
+    const std::vector<uint8_t> bytes;
+    const uint8_t* data;  // Loaded at START_ADDRESS
+    size_t size;
+    uint64_t hash;
+};
+
+struct BasicBlock {
+    uint16_t begin;          // Address of the first instruction
+    uint16_t end;            // One past the last instruction
+    uint16_t successors[2];
+    uint8_t successorCount;
+    bool indirect;           // Ends in 00EE or Bnnn: successors only known at run time
+};
+
+struct RomAnalysis {
+    // Reachable from START_ADDRESS, sorted by address
+    std::vector<BasicBlock> blocks;
+    // Reachable code as instructions, everything else as data bytes
+    std::string listing;
+    bool fromCache = false;  // Read from the cache directory rather than computed
+};
+
+class RomStore {
+public:
+    // An empty cacheDir keeps analysis in memory only
+    explicit RomStore(std::string cacheDir = defaultCacheDir());
+
+    // The store Chip8::loadRom(filename) goes through
+    static RomStore& process();
+    // $CHIP8_CACHE_DIR, else $XDG_CACHE_HOME/chip8, else ~/.cache/chip8
+    static std::string defaultCacheDir();
+
+    // Null if the file can not be read or does not fit in memory; error() says why
+    std::shared_ptr<const RomImage> open(const std::string& path);
+    std::shared_ptr<const RomAnalysis> analyze(const RomImage& rom);
+
+    const std::string& error() const { return lastError; }
+    const std::string& cacheDirectory() const { return cacheDir; }
+
+private:
+    struct FileId {
+        uint64_t device;
+        uint64_t inode;
+        int64_t size;
+        int64_t modified;  // Nanoseconds
+
+        bool operator==(const FileId& other) const {
+            return device == other.device && inode == other.inode && size == other.size &&
+                   modified == other.modified;
+        }
+    };
+
+    struct FileIdHash {
+        size_t operator()(const FileId& id) const { return id.inode * 31 + id.device; }
+    };
+
+    std::shared_ptr<RomAnalysis> loadAnalysis(const RomImage& rom) const;
+    void saveAnalysis(const RomImage& rom, const RomAnalysis& analysis) const;
+    std::string analysisPath(uint64_t hash) const;
+
+    std::string cacheDir;
+    std::string lastError;
+    std::mutex lock;
+    std::unordered_map<FileId, std::weak_ptr<const RomImage>, FileIdHash> byFile;
+    std::unordered_map<uint64_t, std::weak_ptr<const RomImage>> byHash;
+    std::unordered_map<uint64_t, std::shared_ptr<const RomAnalysis>> analyses;
+};
+
+uint64_t fnv1a(const uint8_t* data, size_t size);
+
+// Cowgod-style mnemonic including SCHIP, "DW 0x1234" for unassigned opcodes
+std::string disassemble(uint16_t opcode);
+
+// CFG and listing from scratch, without the cache
+RomAnalysis analyzeRom(const uint8_t* data, size_t size);
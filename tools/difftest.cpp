@@ -0,0 +1,90 @@
+//
+// Differential conformance check between two execution backends on random
+// and corpus ROMs. Mismatching ROMs are shrunk and written out.
+//
+#include <cstdlib>
+#include <fstream>
+#include "../src/DiffTest.h"
+
+
+static bool readFile(const char* path, std::vector<uint8_t>* out){
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    out->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static void usage(const char* argv0){
+    printf("Usage: %s [-a backend] [-b backend] [-q modern|vip|chip48|schip] [-n random roms]\n"
+           "          [-c cycles] [-k block] [-s seed] [-o shrunk.ch8] [rom...]\n"
+           "Backends:", argv0);
+    for (const BackendInfo& backend : BACKENDS) printf(" %s", backend.name);
+    printf("\n");
+}
+
+int main(int argc, char** argv){
+    const BackendInfo* a = &BACKENDS[0];
+    const BackendInfo* b = &BACKENDS[1];
+    DiffConfig config;
+    unsigned int randomRoms = 1000;
+    const char* output = "mismatch.ch8";
+    std::vector<const char*> corpus;
+
+    for (int i=1; i<argc; ++i){
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (argv[i][0] != '-') { corpus.push_back(argv[i]); continue; }
+        if (!value) { usage(argv[0]); return 1; }
+        ++i;
+        if (!std::strcmp(argv[i - 1], "-a")) a = findBackend(value);
+        else if (!std::strcmp(argv[i - 1], "-b")) b = findBackend(value);
+        else if (!std::strcmp(argv[i - 1], "-n")) randomRoms = std::strtoul(value, nullptr, 10);
+        else if (!std::strcmp(argv[i - 1], "-c")) config.cycles = std::strtoull(value, nullptr, 10);
+        else if (!std::strcmp(argv[i - 1], "-k")) config.block = std::strtoul(value, nullptr, 10);
+        else if (!std::strcmp(argv[i - 1], "-s")) config.seed = std::strtoul(value, nullptr, 10);
+        else if (!std::strcmp(argv[i - 1], "-o")) output = value;
+        else if (!std::strcmp(argv[i - 1], "-q")) config.profile = profileFromName(value);
+        else { usage(argv[0]); return 1; }
+        if (!a || !b) { usage(argv[0]); return 1; }
+    }
+
+    unsigned int runs = 0;
+    unsigned int rejected = 0;
+    unsigned int repeated = 0;
+    uint64_t instructions = 0;
+
+    auto check = [&](const std::vector<uint8_t>& rom, const std::string& name, const DiffConfig& romConfig){
+        DiffResult result = lockstep(rom, *a, *b, romConfig);
+        ++runs;
+        instructions += result.cycle;
+        if (result.rejected) ++rejected;
+        if (result.repeated) ++repeated;
+        if (!result.mismatch) return true;
+
+        printf("%s: %s vs %s mismatch at instruction %llu: %s\n", name.c_str(), a->name, b->name,
+               (unsigned long long)result.cycle, result.detail.c_str());
+        std::vector<uint8_t> minimal = shrink(rom, *a, *b, romConfig);
+        std::ofstream(output, std::ios::binary).write((const char*)minimal.data(), minimal.size());
+        printf("Shrunk %zu -> %zu bytes, written to %s\n", rom.size(), minimal.size(), output);
+        return false;
+    };
+
+    for (const char* path : corpus){
+        std::vector<uint8_t> rom;
+        if (!readFile(path, &rom)){
+            printf("Could not read %s\n", path);
+            return 1;
+        }
+        if (!check(rom, path, config)) return 1;
+    }
+
+    for (unsigned int i=0; i<randomRoms; ++i){
+        DiffConfig romConfig = config;
+        romConfig.seed = config.seed + i;
+        std::vector<uint8_t> rom = randomRom(romConfig.seed, 64 + romConfig.seed % 512);
+        if (!check(rom, "random #" + std::to_string(i), romConfig)) return 1;
+    }
+
+    printf("%s and %s agree on %u ROMs, %llu instructions (%u too large to load, %u stopped repeating)\n",
+           a->name, b->name, runs, (unsigned long long)instructions, rejected, repeated);
+    return 0;
+}
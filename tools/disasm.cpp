@@ -0,0 +1,48 @@
+//
+// Disassembly and basic blocks of a ROM. Analysis is read from the ROM
+// store's cache directory when an earlier run left it there.
+//
+#include <cstdlib>
+#include "../src/RomStore.h"
+
+
+int main(int argc, char** argv){
+    if (argc < 2){
+        printf("Usage: %s rom [-d cache dir, empty to disable] [-g]\n", argv[0]);
+        return 1;
+    }
+
+    std::string cacheDir = RomStore::defaultCacheDir();
+    bool graph = false;
+    for (int i=2; i<argc; ++i){
+        if (!std::strcmp(argv[i], "-g")) graph = true;
+        else if (!std::strcmp(argv[i], "-d") && i + 1 < argc) cacheDir = argv[++i];
+    }
+
+    RomStore store(cacheDir);
+    std::shared_ptr<const RomImage> rom = store.open(argv[1]);
+    if (!rom){
+        printf("%s\n", store.error().c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const RomAnalysis> analysis = store.analyze(*rom);
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("; %s, %zu bytes, fnv1a %016llx\n", argv[1], rom->size, (unsigned long long)rom->hash);
+    printf("; %zu blocks, analysis %s in %.1f us\n", analysis->blocks.size(),
+           analysis->fromCache ? "loaded from cache" : "computed", micros);
+
+    if (graph){
+        for (const BasicBlock& block : analysis->blocks){
+            printf("L%03X-%03X ->", block.begin, block.end);
+            for (unsigned int i=0; i<block.successorCount; ++i) printf(" L%03X", block.successors[i]);
+            if (block.indirect) printf(" (indirect)");
+            printf("\n");
+        }
+        return 0;
+    }
+    fputs(analysis->listing.c_str(), stdout);
+    return 0;
+}
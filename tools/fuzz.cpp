@@ -0,0 +1,145 @@
+//
+// Fuzz target feeding arbitrary bytes to the core as ROMs. Built against
+// libFuzzer under clang; other compilers get a small driver (CHIP8_FUZZ_STANDALONE)
+// that replays inputs and mutates them at random, without coverage feedback.
+//
+// Input: byte 0 selects the profile, bytes 1-2 the held keys, the rest is the ROM.
+//
+#include <cstdlib>
+#include "../src/Chip8.h"
+
+// Instructions per input, on each backend
+static const unsigned int FUZZ_CYCLES = 20000;
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 3) return 0;
+
+    // Reset in place: constructing and seeding a Chip8 per input would cost
+    // more than most runs
+    static Chip8 emuSwitch;
+    static Chip8 emuTable;
+
+    auto profile = Profile(data[0] % 4);
+    auto keys = uint16_t(data[1] | data[2] << 8);
+    for (Chip8* emu : {&emuSwitch, &emuTable}) {
+        emu->reset();
+        std::memset(emu->flags, 0, sizeof(emu->flags));  // reset() keeps them
+        emu->seed(1);
+        if (!emu->loadRom(data + 3, size - 3, profile)) return 0;
+        emu->keypad = keys;
+    }
+
+    emuSwitch.run(FUZZ_CYCLES);
+    emuTable.runTable(FUZZ_CYCLES);
+
+    if (std::memcmp(emuSwitch.stateData(), emuTable.stateData(), emuSwitch.stateSize())) {
+        fprintf(stderr, "switch and table backends diverge, profile %u; chip8_difftest -q can narrow it down\n",
+                unsigned(profile));
+        abort();
+    }
+    return 0;
+}
+
+
+#ifdef CHIP8_FUZZ_STANDALONE
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+#include "../src/RomStore.h"
+
+// Every sanitizer report ends in abort(), where the input gets saved
+extern "C" const char* __asan_default_options() { return "abort_on_error=1"; }
+extern "C" const char* __ubsan_default_options() { return "abort_on_error=1:print_stacktrace=1"; }
+
+static std::vector<uint8_t> current;
+
+// Keep the input that killed the process, named like libFuzzer's. The
+// process is going down anyway, so no care for async-signal safety.
+static void onAbort(int) {
+    char name[32];
+    snprintf(name, sizeof(name), "crash-%016llx", (unsigned long long)fnv1a(current.data(), current.size()));
+    std::ofstream(name, std::ios::binary).write((const char*)current.data(), current.size());
+    fprintf(stderr, "Input written to %s\n", name);
+
+    std::signal(SIGABRT, SIG_DFL);
+    std::raise(SIGABRT);
+}
+
+static void run(const std::vector<uint8_t>& input) {
+    current = input;
+    LLVMFuzzerTestOneInput(current.data(), current.size());
+}
+
+static void mutate(std::vector<uint8_t>* input, std::minstd_rand& gen, size_t maxLength) {
+    for (unsigned int edits = 1 + gen() % 4; edits; --edits) {
+        size_t at = input->empty() ? 0 : gen() % input->size();
+        switch (gen() % 4) {
+            case 0:
+                if (!input->empty()) (*input)[at] ^= uint8_t(1u << gen() % 8);
+                break;
+            case 1:
+                if (!input->empty()) (*input)[at] = uint8_t(gen());
+                break;
+            case 2:
+                if (input->size() < maxLength) input->insert(input->begin() + at, uint8_t(gen()));
+                break;
+            default:
+                if (!input->empty()) input->erase(input->begin() + at);
+                break;
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    unsigned long runs = 100000;
+    uint32_t seed = 1;
+    size_t maxLength = 3 + MEMORY_SIZE - START_ADDRESS;
+    std::vector<std::vector<uint8_t>> corpus;
+
+    for (int i=1; i<argc; ++i){
+        if (!std::strncmp(argv[i], "-runs=", 6)) runs = std::strtoul(argv[i] + 6, nullptr, 10);
+        else if (!std::strncmp(argv[i], "-seed=", 6)) seed = std::strtoul(argv[i] + 6, nullptr, 10);
+        else if (!std::strncmp(argv[i], "-max_len=", 9)) maxLength = std::strtoul(argv[i] + 9, nullptr, 10);
+        else if (argv[i][0] == '-'){
+            printf("Usage: %s [-runs=N] [-seed=N] [-max_len=N] [file or directory...]\n", argv[0]);
+            return 1;
+        }
+        else {
+            std::vector<std::filesystem::path> paths;
+            if (std::filesystem::is_directory(argv[i])){
+                for (const auto& entry : std::filesystem::directory_iterator(argv[i])) paths.push_back(entry.path());
+            }
+            else paths.emplace_back(argv[i]);
+            for (const auto& path : paths){
+                std::ifstream file(path, std::ios::binary);
+                corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+        }
+    }
+
+    std::signal(SIGABRT, onAbort);
+
+    // Replay first, so a crashing input reproduces without mutation
+    for (const auto& input : corpus) run(input);
+    if (corpus.empty()) corpus.emplace_back(3, uint8_t(0));
+
+    std::minstd_rand gen(seed);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i=0; i<runs; ++i){
+        std::vector<uint8_t> input = corpus[gen() % corpus.size()];
+        mutate(&input, gen, maxLength);
+        run(input);
+        // Grow the pool so mutations compound
+        if (corpus.size() < 1024 && gen() % 16 == 0) corpus.push_back(std::move(input));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%lu runs in %.1f s, %.0f exec/s\n", runs, elapsed.count(), runs / elapsed.count());
+    return 0;
+}
+
+#endif
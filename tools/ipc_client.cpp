@@ -0,0 +1,126 @@
+//
+// Test client for chip8_ipc_server: loads a ROM, then measures command
+// round-trip latency and frame throughput while reading observations
+// straight out of shared memory.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include "../src/IpcProtocol.h"
+
+
+static bool request(int fd, uint32_t command, uint32_t instance, uint32_t arg, IpcReply* reply, const char* path = ""){
+    IpcRequest req{};
+    req.command = command;
+    req.instance = instance;
+    req.arg = arg;
+    std::strncpy(req.path, path, IPC_PATH_MAX - 1);
+
+    if (send(fd, &req, sizeof(req), 0) != sizeof(req)) return false;
+    if (recv(fd, reply, sizeof(*reply), 0) != sizeof(*reply)) return false;
+    return reply->status == IPC_OK;
+}
+
+int main(int argc, char** argv){
+    if (argc < 2){
+        printf("Usage: %s rom [-s socket] [-m shm name] [-f frames]\n", argv[0]);
+        return 1;
+    }
+    const char* rom = argv[1];
+    const char* socketPath = "/tmp/chip8.sock";
+    const char* shmName = "/chip8";
+    unsigned int frames = 10000;
+
+    for (int i=2; i+1<argc; i+=2){
+        if (!std::strcmp(argv[i], "-s")) socketPath = argv[i+1];
+        else if (!std::strcmp(argv[i], "-m")) shmName = argv[i+1];
+        else if (!std::strcmp(argv[i], "-f")) frames = std::strtoul(argv[i+1], nullptr, 10);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0){
+        perror("connect");
+        return 1;
+    }
+
+    int shmFd = shm_open(shmName, O_RDONLY, 0);
+    if (shmFd < 0){
+        perror("shm_open");
+        return 1;
+    }
+    IpcShmHeader header{};
+    if (read(shmFd, &header, sizeof(header)) != sizeof(header) || header.magic != IPC_MAGIC || header.version != IPC_VERSION){
+        printf("%s is not a chip8 observation ring\n", shmName);
+        return 1;
+    }
+    size_t shmSize = ipcShmSize(header.instances, header.ringSlots);
+    void* mapped = mmap(nullptr, shmSize, PROT_READ, MAP_SHARED, shmFd, 0);
+    close(shmFd);
+    if (mapped == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+    auto* shm = static_cast<const IpcShmHeader*>(mapped);
+
+    IpcReply reply{};
+    if (!request(fd, IPC_LOAD_ROM, 0, uint32_t(Profile::Modern), &reply, rom)){
+        printf("Could not load %s (status %d)\n", rom, reply.status);
+        return 1;
+    }
+
+    // Single-frame steps: latency of one command round trip plus the frame
+    std::vector<double> latencies;
+    latencies.reserve(frames);
+    unsigned long litPixels = 0;
+    unsigned long torn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i=0; i<frames; ++i){
+        request(fd, IPC_SET_KEYS, 0, 1u << (i % 16), &reply);
+        auto t0 = std::chrono::steady_clock::now();
+        request(fd, IPC_STEP, 0, 1, &reply);
+        auto t1 = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+        // The slot must still hold the frame the reply names, before and after reading it
+        const IpcObservation* obs = ipcSlot(shm, 0, reply.slot);
+        if (obs->seq.load(std::memory_order_acquire) != reply.seq){
+            ++torn;
+            continue;
+        }
+        unsigned long lit = 0;
+        for (const auto& row : obs->video)
+            for (uint8_t byte : row) lit += __builtin_popcount(byte);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (obs->seq.load(std::memory_order_relaxed) != reply.seq) ++torn;
+        else litPixels += lit;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("round trip: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+    printf("interactive: %.0f frames/s (%lu lit pixels seen, %lu torn reads)\n", frames / elapsed.count(), litPixels, torn);
+
+    // Batched steps: server-side throughput with the command cost amortised
+    const unsigned int batch = 100;
+    request(fd, IPC_RESET, 0, 0, &reply);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i=0; i<frames; i+=batch) request(fd, IPC_STEP, 0, batch, &reply);
+    elapsed = std::chrono::steady_clock::now() - start;
+    printf("batched x%u: %.0f frames/s, %.2f M instructions/s\n", batch,
+           frames / elapsed.count(), frames * double(CYCLES_PER_FRAME) / elapsed.count() / 1e6);
+
+    munmap(mapped, shmSize);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Headless emulator host for external drivers, see src/IpcProtocol.h
+//
+#include <csignal>
+#include <cstdlib>
+#include "../src/IpcServer.h"
+
+
+static IpcServer* server{};
+
+static void onSignal(int){
+    if (server) server->stop();
+}
+
+int main(int argc, char** argv){
+    const char* socketPath = "/tmp/chip8.sock";
+    const char* shmName = "/chip8";
+    uint32_t instances = 1;
+    FrameCacheConfig cacheConfig;
+    cacheConfig.capacity = 0;
+
+    for (int i=1; i+1<argc; i+=2){
+        if (!std::strcmp(argv[i], "-s")) socketPath = argv[i+1];
+        else if (!std::strcmp(argv[i], "-m")) shmName = argv[i+1];
+        else if (!std::strcmp(argv[i], "-n")) instances = std::strtoul(argv[i+1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "-c")) cacheConfig.capacity = std::strtoul(argv[i+1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "-e")) cacheConfig.eviction = std::strcmp(argv[i+1], "fifo") ? Eviction::LRU : Eviction::FIFO;
+        else {
+            printf("Usage: %s [-s socket] [-m shm name] [-n instances] [-c frame cache entries] [-e lru|fifo]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    IpcServer ipc(socketPath, shmName, instances);
+    if (!ipc.open()) return 1;
+
+    FrameCache cache(cacheConfig);
+    if (cacheConfig.capacity) ipc.setFrameCache(&cache);
+
+    server = &ipc;
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    printf("Serving %u instance(s) on %s, observations in %s\n", instances, socketPath, shmName);
+    ipc.serve();
+
+    if (cacheConfig.capacity){
+        const FrameCacheStats& stats = cache.stats();
+        printf("Frame cache: %llu hits, %llu misses (%.1f%%), %llu evictions, %zu entries, %zu bytes\n",
+               (unsigned long long)stats.hits, (unsigned long long)stats.misses, 100 * stats.hitRate(),
+               (unsigned long long)stats.evictions, stats.entries, stats.bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+//
+// Hardware counter profile of one ROM on one backend. Numbers are host
+// costs per emulated instruction, for comparing dispatch strategies.
+//
+#include <cstdlib>
+#include <fstream>
+#include "../src/PerfCounters.h"
+
+
+int main(int argc, char** argv){
+    if (argc < 2){
+        printf("Usage: %s rom [-b backend] [-f frames] [-q modern|vip|chip48|schip] [-i] [-o frames.csv]\n", argv[0]);
+        return 1;
+    }
+
+    const BackendInfo* backend = &BACKENDS[0];
+    unsigned int frames = 100000;
+    Profile profile = Profile::Modern;
+    bool perInstruction = false;
+    const char* csv = nullptr;
+
+    for (int i=2; i<argc; ++i){
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (!std::strcmp(argv[i], "-i")) perInstruction = true;
+        else if (!std::strcmp(argv[i], "-b")) { backend = findBackend(value); ++i; }
+        else if (!std::strcmp(argv[i], "-f")) { frames = std::strtoul(value, nullptr, 10); ++i; }
+        else if (!std::strcmp(argv[i], "-o")) { csv = value; ++i; }
+        else if (!std::strcmp(argv[i], "-q")) { profile = profileFromName(value); ++i; }
+        if (!backend){
+            printf("Unknown backend\n");
+            return 1;
+        }
+    }
+
+    Chip8 emu;
+    emu.seed(1);
+    if (!emu.loadRom(argv[1], profile)){
+        printf("Could not load %s\n", argv[1]);
+        return 1;
+    }
+
+    PerfCounters counters;
+    counters.open();
+    PerfReport report = profileFrames(emu, *backend, frames, counters, perInstruction);
+    printf("backend %s\n", backend->name);
+    printReport(report, counters);
+
+    if (csv){
+        std::ofstream out(csv);
+        out << "frame,cycles,instructions,branch_misses,l1d_misses\n";
+        for (size_t frame=0; frame<report.perFrame.size(); ++frame){
+            const PerfSample& s = report.perFrame[frame];
+            out << frame << ',' << s.value[PERF_CYCLES] << ',' << s.value[PERF_INSTRUCTIONS] << ','
+                << s.value[PERF_BRANCH_MISSES] << ',' << s.value[PERF_L1D_MISSES] << '\n';
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+//
+// SCHIP display checks against a per-pixel reference model: xorRow clipping,
+// the 00Cn / 00FB / 00FC scrolls, 8xN and 16x16 sprites and the observation
+// export, in both display modes and on both backends. CMake builds it twice,
+// once with the SSE2 paths compiled out, and ctest runs both.
+//
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../src/Batch.h"
+#include "../src/Chip8.h"
+
+// Where test instructions are placed, away from the sprite data
+static const uint16_t TEST_ADDRESS = 0x300;
+static const uint16_t SPRITE_ADDRESS = 0x400;
+
+// The display as one bool per pixel of the current mode
+struct Model {
+    bool pixels[VIDEO_HEIGHT][VIDEO_WIDTH]{};
+    bool hires = false;
+
+    int width() const { return hires ? VIDEO_WIDTH : LORES_WIDTH; }
+    int height() const { return hires ? VIDEO_HEIGHT : LORES_HEIGHT; }
+    // Same coordinates as Chip8::pixel()
+    bool frame(int x, int y) const { return hires ? pixels[y][x] : pixels[y / 2][x / 2]; }
+
+    void setMode(bool high) {
+        hires = high;
+        std::memset(pixels, 0, sizeof(pixels));
+    }
+
+    void scrollDown(int n) {
+        for (int y=height()-1; y>=0; --y)
+            for (int x=0; x<width(); ++x) pixels[y][x] = y >= n ? pixels[y - n][x] : false;
+    }
+
+    void scrollRight(int n) {
+        for (int y=0; y<height(); ++y)
+            for (int x=width()-1; x>=0; --x) pixels[y][x] = x >= n ? pixels[y][x - n] : false;
+    }
+
+    void scrollLeft(int n) {
+        for (int y=0; y<height(); ++y)
+            for (int x=0; x<width(); ++x) pixels[y][x] = x + n < width() ? pixels[y][x + n] : false;
+    }
+
+    // XOR a sprite of rows x cols (8 or 16) pixels at (x0, y0), clipped at the
+    // right and bottom edges. True if it erased a lit pixel.
+    bool draw(int x0, int y0, int rows, int cols, const uint8_t* sprite) {
+        bool erased = false;
+        for (int row=0; row<rows && y0 + row < height(); ++row) {
+            for (int col=0; col<cols && x0 + col < width(); ++col) {
+                uint8_t byte = sprite[row * cols / 8 + col / 8];
+                if (!(byte >> (7 - col % 8) & 1u)) continue;
+                erased |= pixels[y0 + row][x0 + col];
+                pixels[y0 + row][x0 + col] = !pixels[y0 + row][x0 + col];
+            }
+        }
+        return erased;
+    }
+};
+
+static unsigned int failures = 0;
+
+static void expect(bool ok, const char* what, unsigned int trial = 0, unsigned int step = 0) {
+    if (ok) return;
+    // The first few are enough to go on
+    if (++failures <= 10) printf("FAIL %s (trial %u, step %u)\n", what, trial, step);
+}
+
+// Run one instruction placed at TEST_ADDRESS
+static void execute(Chip8& emu, uint16_t opcode, bool table) {
+    emu.pc = TEST_ADDRESS;
+    emu.mem[TEST_ADDRESS] = opcode >> 8u;
+    emu.mem[TEST_ADDRESS + 1] = opcode & 0xFFu;
+    if (table) emu.runTable(1);
+    else emu.run(1);
+}
+
+// pixel() and every export format against the model
+static bool sameDisplay(const Chip8& emu, const Model& model) {
+    if (emu.hires != model.hires) return false;
+
+    std::vector<uint8_t> packed(observationSize(ObsFormat::Packed1));
+    std::vector<uint8_t> bytes(observationSize(ObsFormat::U8));
+    std::vector<uint8_t> down(observationSize(ObsFormat::Down2x));
+    exportObservation(emu, ObsFormat::Packed1, packed.data());
+    exportObservation(emu, ObsFormat::U8, bytes.data());
+    exportObservation(emu, ObsFormat::Down2x, down.data());
+
+    for (int y=0; y<VIDEO_HEIGHT; ++y) {
+        for (int x=0; x<VIDEO_WIDTH; ++x) {
+            bool lit = model.frame(x, y);
+            if (emu.pixel(x, y) != lit) return false;
+            if ((packed[y * VIDEO_WIDTH / 8 + x / 8] >> (7 - x % 8) & 1u) != lit) return false;
+            if (bytes[y * VIDEO_WIDTH + x] != lit) return false;
+        }
+    }
+    for (int y=0; y<VIDEO_HEIGHT/2; ++y) {
+        for (int x=0; x<VIDEO_WIDTH/2; ++x) {
+            bool any = model.frame(2 * x, 2 * y) || model.frame(2 * x + 1, 2 * y) ||
+                       model.frame(2 * x, 2 * y + 1) || model.frame(2 * x + 1, 2 * y + 1);
+            if (down[y * VIDEO_WIDTH / 2 + x] != any) return false;
+        }
+    }
+
+    // Low-res only ever uses word 0 of the first LORES_HEIGHT rows
+    if (!emu.hires) {
+        for (int y=0; y<VIDEO_HEIGHT; ++y) {
+            if (emu.video[y][1] || (y >= LORES_HEIGHT && emu.video[y][0])) return false;
+        }
+    }
+    return true;
+}
+
+// Sprite rows at the edges of either mode, and across the word boundary
+static void checkXorRow() {
+    Chip8 emu;
+    const uint64_t BYTE = 0xFFull << 56;
+    const uint64_t WORD = 0xFFFFull << 48;
+
+    // Low-res: clipped at column 64, nothing reaches word 1
+    expect(!emu.xorRow(0, 60, BYTE), "lores xorRow reported a collision on a clear row");
+    expect(emu.video[0][0] == 0xFull && emu.video[0][1] == 0, "lores xorRow not clipped at the right edge");
+    expect(emu.xorRow(0, 60, BYTE), "lores xorRow missed a collision");
+    expect(emu.video[0][0] == 0 && emu.video[0][1] == 0, "lores xorRow did not erase");
+
+    emu.hires = true;
+    // Hi-res: 8 pixels straddling the two words
+    expect(!emu.xorRow(1, 60, BYTE), "hires xorRow reported a collision on a clear row");
+    expect(emu.video[1][0] == 0xFull && emu.video[1][1] == 0xFull << 60, "hires xorRow split across words");
+    // 16 pixels clipped at column 128
+    emu.xorRow(2, 124, WORD);
+    expect(emu.video[2][0] == 0 && emu.video[2][1] == 0xFull, "hires xorRow not clipped at the right edge");
+    // Aligned at either word
+    emu.xorRow(3, 0, WORD);
+    emu.xorRow(3, 64, WORD);
+    expect(emu.video[3][0] == WORD && emu.video[3][1] == WORD, "hires xorRow at a word boundary");
+    // A collision in word 1 alone counts
+    expect(emu.xorRow(3, 70, BYTE), "hires xorRow missed a collision in the right word");
+}
+
+// Random modes, scrolls and sprites, checked after every instruction
+static void checkRandom(uint32_t seed, unsigned int trials) {
+    std::mt19937 gen(seed);
+    for (unsigned int trial=0; trial<trials; ++trial) {
+        const bool table = trial % 2;
+        Chip8 emu;
+        emu.setProfile(Profile::SuperChip);
+        Model model;
+
+        for (unsigned int step=0; step<60; ++step) {
+            unsigned int kind = gen() % 7;
+            if (kind == 0) {
+                bool high = gen() % 2;
+                execute(emu, high ? 0x00FF : 0x00FE, table);
+                model.setMode(high);
+            }
+            else if (kind == 1) {
+                unsigned int n = gen() % 16;
+                execute(emu, uint16_t(0x00C0 | n), table);
+                model.scrollDown(int(n));
+            }
+            else if (kind == 2) {
+                execute(emu, 0x00FB, table);
+                model.scrollRight(4);
+            }
+            else if (kind == 3) {
+                execute(emu, 0x00FC, table);
+                model.scrollLeft(4);
+            }
+            else {
+                // Dxyn, with Dxy0 drawing 16x16 from 32 bytes
+                unsigned int n = gen() % 16;
+                emu.registers[1] = uint8_t(gen());
+                emu.registers[2] = uint8_t(gen());
+                emu.index = SPRITE_ADDRESS;
+                for (unsigned int i=0; i<32; ++i) emu.mem[SPRITE_ADDRESS + i] = uint8_t(gen());
+
+                int x0 = emu.registers[1] % model.width();
+                int y0 = emu.registers[2] % model.height();
+                bool erased = model.draw(x0, y0, n ? int(n) : 16, n ? 8 : 16, &emu.mem[SPRITE_ADDRESS]);
+                execute(emu, uint16_t(0xD120 | n), table);
+                expect(emu.registers[0xF] == erased, n ? "Dxyn collision flag" : "Dxy0 collision flag", trial, step);
+            }
+            expect(sameDisplay(emu, model), "display differs from the model", trial, step);
+        }
+    }
+}
+
+static void checkExtendedOps() {
+    Chip8 emu;
+    emu.setProfile(Profile::SuperChip);
+    emu.registers[3] = 7;
+    execute(emu, 0xF330, false);
+    expect(emu.index == BIG_FONT_ADDRESS + 7 * 10, "Fx30 points at the 10-byte digit");
+
+    for (unsigned int i=0; i<16; ++i) emu.registers[i] = uint8_t(i + 1);
+    execute(emu, 0xF575, false);
+    std::memset(emu.registers, 0, sizeof(emu.registers));
+    execute(emu, 0xF385, false);
+    expect(emu.registers[0] == 1 && emu.registers[3] == 4 && emu.registers[4] == 0, "Fx75/Fx85 round trip V0..Vx");
+
+    execute(emu, 0x00FD, false);
+    emu.run(4);
+    expect(emu.pc == TEST_ADDRESS, "00FD halts");
+
+    // Not an instruction outside SCHIP
+    Chip8 modern;
+    execute(modern, 0x00FF, false);
+    expect(!modern.hires && modern.pc == TEST_ADDRESS + 2, "00FF is a no-op under Modern");
+}
+
+int main(int argc, char** argv){
+    unsigned int trials = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+
+#ifdef __SSE2__
+    printf("SSE2 scroll paths\n");
+#else
+    printf("scalar scroll paths\n");
+#endif
+
+    checkXorRow();
+    checkRandom(5, trials);
+    checkExtendedOps();
+
+    if (failures) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed, %u random trials\n", trials);
+    return 0;
+}